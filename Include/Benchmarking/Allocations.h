@@ -0,0 +1,51 @@
+// ===--- Allocations.h ------------------------------------------ C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for counting heap allocations in benchmarks.                 //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include <stdint.h>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// The heap allocations made by a thread.
+/// \remarks
+///   Only counted when built with `EXPECT_ALLOCATION_TRACKING` defined to `1`,
+///   which replaces `malloc` and its relatives where the C library allows it,
+///   and the global `operator new` and `operator delete` elsewhere.
+struct AllocationCounters {
+  /// The number of allocations made.
+  uint64_t allocations;
+  
+  /// The number of bytes requested by the allocations made.
+  uint64_t bytes;
+  
+  /// The number of bytes held by the allocations made and not yet freed by the
+  /// thread.
+  /// \remarks
+  ///   Counts the whole block given by the allocator, which may be larger than
+  ///   requested, and may go below zero if the thread frees memory allocated by
+  ///   another thread.
+  long long live;
+  
+  /// The most bytes that were live at once, since it was last set.
+  long long peak;
+};
+
+/// Get the heap allocations made by the calling thread.
+/// \returns
+///   The allocation counters of the calling thread, which stay zero unless
+///   allocations are tracked.
+AllocationCounters &allocationCounters();
+
+
+
+END_NAMESPACE_EXPECT
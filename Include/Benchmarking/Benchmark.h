@@ -11,6 +11,8 @@
 #pragma once
 #include <Expect Common.h>
 #include <Global/Environment.h>
+#include "Counters.h"
+#include "Allocations.h"
 #include <vector>
 #include <chrono>
 #include <algorithm>
@@ -23,8 +25,9 @@ START_NAMESPACE_EXPECT
 struct Benchmark {
   /// The test environment that the benchmark operates in.
   Environment &environment;
-  /// The times (in nanoseconds) of each iteration.
-  std::vector<long long> times { };
+  /// The times (in nanoseconds) that the benchmarked code took to run once in
+  /// each iteration.
+  std::vector<double> times { };
   /// The total time (in nanoseconds) that the benchmark has run.
   long long totalTime = 0;
   /// The number of iterations that the benchmark has run.
@@ -33,6 +36,34 @@ struct Benchmark {
   std::chrono::steady_clock::time_point start;
   /// The line number on which the benchmark occurs.
   int line;
+  /// The number of iterations after which to next check whether the median
+  /// time is precise enough to stop.
+  size_t nextCheck = 0;
+  /// The number of times to run the benchmarked code in each iteration.
+  size_t batch = 1;
+  /// The number of times that the benchmarked code has run in the current
+  /// iteration.
+  size_t repeat = 0;
+  /// Whether or not the batch size is still being calibrated.
+  bool calibrating = true;
+  /// The hardware performance counters, if they are being collected.
+  PerformanceCounters counters { };
+  /// Whether or not the hardware performance counters have been read around
+  /// every iteration so far.
+  bool counting = false;
+  /// The hardware performance counters at the start of the current iteration.
+  uint64_t counted[(size_t)Counter::Count];
+  /// The total of each hardware performance counter over every iteration.
+  uint64_t counterTotals[(size_t)Counter::Count] { };
+  /// How much each hardware performance counter counts around an empty
+  /// iteration, from reading the clock and the counters themselves.
+  uint64_t counterOverhead[(size_t)Counter::Count] { };
+  /// The heap allocations of the thread at the start of the current
+  /// iteration.
+  AllocationCounters allocated { };
+  /// The heap allocations made over every iteration, with the most bytes live
+  /// at once during any iteration above those live when it began as the peak.
+  AllocationCounters allocationTotals { };
   
   /// Create a new benchmark handler.
   /// \param[inout] environment
@@ -44,16 +75,46 @@ struct Benchmark {
     const int    line
   );
   
+  /// Check whether to continue running benchmarks, and begin the next benchmark
+  /// iteration, if applicable.
+  /// \returns
+  ///   Whether or not to run the benchmarked code again.
+  /// \remarks
+  ///   Inline so that running the benchmarked code again within an iteration
+  ///   costs as little as possible.
+  bool operator()() {
+    return repeat > 0 || next();
+  }
+  
+  /// Count a run of the benchmarked code, ending the benchmark iteration once
+  /// it has run a whole batch of times.
+  void operator++(int) {
+    if (++repeat >= batch)
+      finish();
+  }
+  
   /// Check whether to continue running benchmarks, and begin the next benchmark
   /// iteration, if applicable.
   /// \returns
   ///   Whether or not to run another benchmark iteration.
-  bool operator()();
+  bool next();
   
   /// End a benchmark iteration.
-  void operator++(int);
+  void finish();
 };
 
+/// Get how long reading the clock takes, measured the first time that this is
+/// called.
+/// \returns
+///   The median time between two consecutive clock readings, in nanoseconds.
+long long timerOverhead();
+
+/// Get the smallest step that the clock takes, measured the first time that
+/// this is called.
+/// \returns
+///   The smallest nonzero time between two clock readings, in nanoseconds.
+long long timerResolution();
+
 
 
 END_NAMESPACE_EXPECT
@@ -69,6 +130,10 @@ END_NAMESPACE_EXPECT
 ///   A `benchmark` tag can be added to test cases that employ benchmarks to
 ///   prevent them from being run in aggregate unit tests, such as when an
 ///   entire test suite is specified to be tested.
+///   Code that runs for less than about a thousand times the cost of reading
+///   the clock is run in batches, so that each iteration times a whole batch
+///   of runs, and results are given per run with the cost of reading the
+///   clock taken out.
 ///   Example:
 ///   ```
 ///   TEST(my benchmark, "A description.", benchmark) {
@@ -0,0 +1,78 @@
+// ===--- Counters.h --------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for reading hardware performance counters in benchmarks.     //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include <stdint.h>
+#include <stddef.h>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// The hardware performance counters that benchmarks can collect.
+enum class Counter {
+  Cycles      , //< CPU cycles.
+  Instructions, //< Retired instructions.
+  BranchMisses, //< Mispredicted branches.
+  L1dMisses   , //< Level 1 data cache read misses.
+  LLCMisses   , //< Last level cache read misses.
+  DTLBMisses  , //< Data TLB read misses.
+  Count       , //< The number of counters.
+};
+
+/// The hardware performance counters of the calling thread, counting in user
+/// space only.
+/// \remarks
+///   Built on `perf_event_open`, so only supported on Linux.
+///   The counters are opened as a group, so that they all count over exactly
+///   the same time.
+///   Counters that the CPU doesn't have, or that aren't allowed, such as in
+///   containers or by `perf_event_paranoid`, are left out.
+struct PerformanceCounters {
+  /// The file of each counter, or `-1` for the counters that aren't open.
+  /// The first open counter leads the group.
+  int files[(size_t)Counter::Count];
+  
+  /// The position of each open counter in a read of the group.
+  size_t positions[(size_t)Counter::Count];
+  
+  /// The number of open counters.
+  size_t open = 0;
+  
+  /// Create closed performance counters.
+  PerformanceCounters();
+  
+  /// Close the performance counters.
+  ~PerformanceCounters();
+  
+  PerformanceCounters(const PerformanceCounters &) = delete;
+  PerformanceCounters &operator = (const PerformanceCounters &) = delete;
+  
+  /// Open and start the performance counters.
+  /// \returns
+  ///   Whether or not any performance counter could be opened.
+  bool start();
+  
+  /// Close the performance counters.
+  void stop();
+  
+  /// Read the performance counters.
+  /// \param[out] values
+  ///   The value of each counter, left alone for the counters that aren't
+  ///   open.
+  /// \returns
+  ///   Whether or not the counters could be read while they were counting.
+  bool read(uint64_t values[(size_t)Counter::Count]);
+};
+
+
+
+END_NAMESPACE_EXPECT
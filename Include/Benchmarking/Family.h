@@ -0,0 +1,199 @@
+// ===--- Family.h ----------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for benchmark families and fitting their complexity.         //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include <Global/Environment.h>
+#include <initializer_list>
+#include <vector>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// A sweep of a benchmark family over the values of a parameter.
+struct BenchmarkFamily {
+  /// The test environment that the benchmark family operates in.
+  Environment &environment;
+  /// The name of the parameter.
+  const char *name;
+  /// The values of the parameter to sweep over.
+  std::vector<long long> values;
+  /// The index of the current value.
+  size_t index = 0;
+  /// Whether or not the current value is in the parameters of the
+  /// environment.
+  bool pushed = false;
+  
+  /// Create a new benchmark family.
+  /// \param[inout] environment
+  ///   The benchmark family's test environment.
+  /// \param[in] name
+  ///   The name of the parameter.
+  /// \param[in] values
+  ///   The values of the parameter to sweep over.
+  BenchmarkFamily(
+    Environment            &environment,
+    const char             *name,
+    std::vector<long long>  values
+  );
+  
+  /// Remove the current value from the parameters of the environment, if the
+  /// sweep was left early.
+  ~BenchmarkFamily();
+  
+  BenchmarkFamily(const BenchmarkFamily &) = delete;
+  BenchmarkFamily &operator = (const BenchmarkFamily &) = delete;
+  
+  /// Check whether to continue the sweep, and add the next value to the
+  /// parameters of the environment, if applicable.
+  /// \returns
+  ///   Whether or not to run the benchmarks of the family for another value.
+  bool operator()();
+  
+  /// Move on to the next value.
+  void operator++(int);
+  
+  /// Get the current value.
+  /// \returns
+  ///   The current value of the parameter.
+  long long value() const {
+    return values[index];
+  }
+};
+
+/// Get the values of a range.
+/// \param[in] first
+///   The first value.
+/// \param[in] last
+///   The last value, included if the range reaches it.
+/// \param[in] step
+///   The difference between consecutive values.
+/// \returns
+///   The values from `first` to `last` in steps of `step`, or none if `step`
+///   isn't positive.
+std::vector<long long> parameterRange(
+  long long first,
+  long long last,
+  long long step = 1
+);
+
+/// Get the powers of two within a range.
+/// \param[in] first
+///   The smallest value.
+/// \param[in] last
+///   The largest value.
+/// \returns
+///   The powers of two from `first` to `last`.
+std::vector<long long> parameterPowers(
+  long long first,
+  long long last
+);
+
+/// The complexity classes that benchmark families are fitted to.
+enum class Complexity {
+  Constant    , //< O(1).
+  Logarithmic , //< O(log n).
+  Linear      , //< O(n).
+  Linearithmic, //< O(n log n).
+  Quadratic   , //< O(n^2).
+};
+
+/// The complexity class that best fits the median times of a benchmark family.
+struct ComplexityFit {
+  /// The line number of the benchmark.
+  int line;
+  /// The parameters of the enclosing benchmark families, which were the same
+  /// for every point, outermost first.
+  std::vector<BenchmarkParameter> parameters;
+  /// The name of the parameter that the family swept over.
+  std::string name;
+  /// The number of points fitted.
+  size_t points;
+  /// The complexity class that fits best.
+  Complexity complexity;
+  /// The coefficient of the complexity class, in nanoseconds.
+  double coefficient;
+  /// The root mean square error of the fit, relative to the mean of the
+  /// median times.
+  double rms;
+};
+
+/// Fit the median times of the benchmark families in some benchmark results
+/// to each complexity class.
+/// \param[in] benchmarks
+///   The benchmark results of a test case.
+/// \returns
+///   The complexity class with the least error for each sweep over at least
+///   two different values, in the order that the sweeps began.
+/// \remarks
+///   The innermost parameter is taken as `n`, and results that share a line
+///   and the values of every other parameter make up a sweep.
+///   A simpler complexity class is kept when the errors are equal.
+std::vector<ComplexityFit> fitComplexity(
+  const std::vector<BenchmarkResult> &benchmarks
+);
+
+/// Get the name of a complexity class.
+/// \param[in] complexity
+///   The complexity class.
+/// \returns
+///   The big O notation of the complexity class.
+const char *complexityName(Complexity complexity);
+
+
+
+END_NAMESPACE_EXPECT
+
+
+
+/// Run the benchmarks in a block of code for each of a list of values of a
+/// parameter.
+/// \remarks
+///   Every `BENCHMARK` inside the block gives a result for each value, which
+///   records the value in its parameters, so code before a benchmark can set
+///   up its input without being timed.
+///   Families can be nested to sweep over more than one parameter, in which
+///   case the complexity is fitted to the innermost.
+///   The sweep stops once an expectation or assertion in the test case fails.
+///   Example:
+///   ```
+///   TEST(lookup benchmark, "A description.", benchmark) {
+///     BENCHMARK_FAMILY(n, 10, 100, 1000) {
+///       std::set<long long> set = numbersUpTo(n);
+///       BENCHMARK set.find(n / 2);
+///     }
+///   };
+///   ```
+#define BENCHMARK_FAMILY(parameter, ...) \
+  _EXPECT_BENCHMARK_SWEEP(parameter, std::vector<long long> { __VA_ARGS__ })
+
+/// Run the benchmarks in a block of code for each value of a parameter in a
+/// range from `first` to `last`, in steps of `step`.
+/// \remarks
+///   See `BENCHMARK_FAMILY`.
+#define BENCHMARK_RANGE(parameter, first, last, step) \
+  _EXPECT_BENCHMARK_SWEEP( \
+    parameter, NAMESPACE_EXPECT parameterRange(first, last, step))
+
+/// Run the benchmarks in a block of code for each value of a parameter that is
+/// a power of two from `first` to `last`.
+/// \remarks
+///   See `BENCHMARK_FAMILY`.
+#define BENCHMARK_POWERS(parameter, first, last) \
+  _EXPECT_BENCHMARK_SWEEP( \
+    parameter, NAMESPACE_EXPECT parameterPowers(first, last))
+
+/// Run a block of code for each of a list of values of a parameter.
+#define _EXPECT_BENCHMARK_SWEEP(parameter, ...) \
+  for (NAMESPACE_EXPECT BenchmarkFamily __family { \
+      __environment, #parameter, __VA_ARGS__ }; \
+    __family(); __family++) \
+    for (const long long parameter : { __family.value() })
@@ -0,0 +1,100 @@
+// ===--- Cache.h ------------------------------------------------ C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for skipping test cases that passed in an identical build.   //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include <Global/Environment.h>
+#include <Suite/Suite.h>
+#include <unordered_set>
+#include <vector>
+#include <string>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// A cache of the test cases that passed in previous runs of the same test
+/// executable with the same flags.
+/// \remarks
+///   Stored in a directory with one text file per build of the test
+///   executable and set of flags, named by the build-id of the executable (or
+///   a hash of its contents if it has none) and a hash of the flags.
+///   Each line of a file holds the test suite name and the test case name of a
+///   passed test case, separated by a tab.
+///   Test cases tagged `benchmark` or `nocache` are never cached.
+struct ResultCache {
+  /// The path of the cache file for this build and set of flags.
+  std::string path = "";
+  
+  /// The test cases that passed, keyed by the test suite and test case name.
+  std::unordered_set<std::string> passed { };
+  
+  /// Open the cache file for this build and set of flags in a cache directory,
+  /// creating the directory if needed.
+  /// \param[in] directory
+  ///   The path of the cache directory.
+  /// \param[in] executable
+  ///   The path of the test executable, to hash if it has no build-id.
+  /// \param[in] plugins
+  ///   The paths of the loaded test plugins.
+  /// \param[in] environment
+  ///   The testing environment that the test cases are run with.
+  /// \returns
+  ///   Whether or not the test executable could be identified and the cache
+  ///   directory could be created.
+  bool open(
+    const char                     *directory  ,
+    const char                     *executable ,
+    const std::vector<std::string> &plugins    ,
+    const Environment              &environment
+  );
+  
+  /// Save the passed test cases to the cache file.
+  /// \returns
+  ///   Whether or not the cache file could be written.
+  bool save();
+  
+  /// Get whether or not a test case already passed and can be skipped.
+  /// \param[in] suite
+  ///   The test suite that the test case is in.
+  /// \param[in] test
+  ///   The test case.
+  bool cached(Suite &suite, Test &test);
+  
+  /// Record the outcome of a test case.
+  /// \param[in] suite
+  ///   The test suite that the test case is in.
+  /// \param[in] test
+  ///   The test case.
+  /// \param[in] success
+  ///   Whether or not the test case passed.
+  void record(Suite &suite, Test &test, bool success);
+};
+
+/// Get an identifier of the build of the running test executable and the
+/// objects that it has loaded, such as test plugins.
+/// \param[in] executable
+///   The path of the test executable, to hash if it has no build-id.
+/// \param[in] plugins
+///   The paths of the loaded test plugins, hashed where the loaded objects
+///   can't be listed.
+/// \returns
+///   The hexadecimal GNU build-id of the executable if it has one, otherwise a
+///   hash of its contents, followed by a hash of the identifiers of the other
+///   loaded objects if there are any, or an empty string if the executable
+///   couldn't be identified.
+std::string buildIdentifier(
+  const char                     *executable,
+  const std::vector<std::string> &plugins = { }
+);
+
+
+
+END_NAMESPACE_EXPECT
@@ -0,0 +1,77 @@
+// ===--- Changes.h ---------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for selecting test cases by the source files that changed.   //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include <Suite/Suite.h>
+#include <unordered_map>
+#include <string>
+#include <vector>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// A map of the source files that depend on each source file, so that a change
+/// to a file also selects the test cases defined in the files that depend on
+/// it.
+/// \remarks
+///   Stored as a text file with one file per line, written as the file
+///   followed by a colon and the files that depend on it, separated by
+///   whitespace, as in `Source/Number.cpp: Tests/Number.cpp Tests/Math.cpp`.
+///   Lines starting with `#` are ignored.
+struct DependencyMap {
+  /// The files that directly depend on each file, keyed by the file.
+  std::unordered_map<std::string, std::vector<std::string>> dependents { };
+  
+  /// Load a dependency map.
+  /// \param[in] path
+  ///   The path of the dependency map file.
+  /// \returns
+  ///   Whether or not the dependency map file could be read.
+  bool load(const char *path);
+  
+  /// Add every file that depends on a list of files, directly or indirectly,
+  /// to the list.
+  /// \param[inout] files
+  ///   The list of files.
+  void extend(std::vector<std::string> &files) const;
+};
+
+/// Get whether or not two paths name the same file, allowing either to be
+/// relative to a directory that the other includes, as with a path relative
+/// to the repository root and an absolute path.
+/// \param[in] lhs
+///   The first path.
+/// \param[in] rhs
+///   The second path.
+bool samePath(const char *lhs, const char *rhs);
+
+/// Get the files changed since a revision, according to `git`.
+/// \param[in] revision
+///   The revision to compare against, such as `HEAD` or `origin/main`.
+/// \param[out] files
+///   The changed files, relative to the repository root, including
+///   uncommitted changes and untracked files.
+/// \returns
+///   Whether or not `git` could list the changed files.
+bool changedFiles(const char *revision, std::vector<std::string> &files);
+
+/// Enable the test cases defined in any of a list of files, except for those
+/// tagged `benchmark` or `skip`.
+/// \param[in] files
+///   The source files.
+/// \returns
+///   The number of test cases enabled.
+size_t enableTestsInFiles(const std::vector<std::string> &files);
+
+
+
+END_NAMESPACE_EXPECT
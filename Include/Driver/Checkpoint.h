@@ -0,0 +1,104 @@
+// ===--- Checkpoint.h ------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for resuming interrupted test runs.                          //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include "Driver.h"
+#include <unordered_map>
+#include <string>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// A journal of the test cases that finished in a test run, so that the test
+/// run can be resumed if it is interrupted.
+/// \remarks
+///   Stored as a file of messages, as sent by `sendMessage`, each holding the
+///   test suite name, the test case name, whether or not the test case timed
+///   out, and the result of the test case.
+///   An entry cut short by an interruption is ignored.
+struct Checkpoint {
+  /// The results of the test cases that finished in the journaled test run,
+  /// keyed by the test suite and test case name.
+  std::unordered_map<std::string, TestResult> results { };
+  
+  /// The journal file that finished test cases are appended to, or `-1` if it
+  /// isn't open.
+  int file = -1;
+  
+  /// The length of the complete entries in the loaded journal file, in bytes.
+  long long length = 0;
+  
+  /// Load the results of a journaled test run.
+  /// \param[in] path
+  ///   The path of the journal file.
+  /// \returns
+  ///   Whether or not the journal file could be read.
+  bool load(const char *path);
+  
+  /// Open a journal file to append finished test cases to.
+  /// \param[in] path
+  ///   The path of the journal file.
+  /// \param[in] resume
+  ///   Whether to keep the complete entries of the loaded journal file,
+  ///   instead of starting a new test run.
+  /// \returns
+  ///   Whether or not the journal file could be opened.
+  bool open(const char *path, bool resume);
+  
+  /// Close the journal file.
+  void close();
+  
+  /// Get the result of a test case that finished in the journaled test run.
+  /// \param[in] suite
+  ///   The test suite that the test case is in.
+  /// \param[in] test
+  ///   The test case.
+  /// \returns
+  ///   The result of the test case, or `nullptr` if it didn't finish.
+  const TestResult *find(Suite &suite, Test &test) const;
+  
+  /// Append a finished test case to the journal file.
+  /// \param[in] suite
+  ///   The test suite that the test case is in.
+  /// \param[in] test
+  ///   The test case.
+  /// \param[in] result
+  ///   The result of the test case.
+  void record(Suite &suite, Test &test, const TestResult &result);
+};
+
+/// Run a schedule of test cases, skipping the test cases that finished in a
+/// journaled test run and journaling the rest as they finish.
+/// \param[in] schedule
+///   The test cases to run.
+///   The test cases of a test suite must be listed next to each other.
+/// \param[inout] checkpoint
+///   The journal of the test run to resume.
+/// \param[in] state
+///   The run state handler.
+///   Called in schedule order for every test case, including the skipped
+///   test cases with their journaled results.
+/// \param[in] run
+///   Runs the test cases that didn't finish, such as with `runTests`.
+/// \returns
+///   A report of the test run, including the skipped test cases.
+Report resumeTests(
+  std::vector<ScheduledTest>     &schedule  ,
+  Checkpoint                     &checkpoint,
+  std::function<void(RunState &)> state     ,
+  std::function<Report(
+    std::vector<ScheduledTest> &, std::function<void(RunState &)>)> run
+);
+
+
+
+END_NAMESPACE_EXPECT
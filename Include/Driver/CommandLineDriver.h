@@ -20,6 +20,23 @@ int runCommandLineTests(
   char *argv[]
 );
 
+/// Run the command line test driver, sending its output to a test daemon
+/// client.
+/// \param[in] argc
+///   The standard `argc` command line argument.
+/// \param[in] argv
+///   The standard `argv` command line argument.
+/// \param[in] output
+///   The client connection to send output and run states to, or `-1` to
+///   print to standard output.
+/// \returns
+///   The exit status of the driver.
+int runCommandLineTests(
+  int   argc  ,
+  char *argv[],
+  int   output
+);
+
 
 
 END_NAMESPACE_EXPECT
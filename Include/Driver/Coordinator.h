@@ -0,0 +1,67 @@
+// ===--- Coordinator.h ------------------------------------------ C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for handing test cases out to worker processes over sockets. //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include "Driver.h"
+
+START_NAMESPACE_EXPECT
+
+
+
+/// Run a schedule of test cases on worker processes that connect to a socket.
+/// \param[in] environment
+///   The test environment to run the test cases in.
+///   Sent to every worker process, which runs its test cases in its own copy
+///   of the environment.
+/// \param[in] schedule
+///   The test cases to run.
+///   The test cases of a test suite must be listed next to each other.
+/// \param[in] address
+///   The address to listen on for worker processes: either the path of a Unix
+///   socket, or `tcp:PORT` or `tcp:HOST:PORT` for a TCP socket.
+///   Any existing Unix socket at the path is replaced.
+/// \param[in] state
+///   The run state handler.
+///   Always called from the calling process, in schedule order.
+/// \returns
+///   A report of the test run, or an empty report if the address couldn't be
+///   listened on.
+/// \remarks
+///   Any number of worker processes may connect at any time during the run,
+///   each pulling batches of test cases, longest first, that shrink as the
+///   run nears its end.
+///   A worker process that disconnects or runs out of time while running a
+///   test case fails that test case, and the rest of its batch is handed out
+///   again.
+///   A worker process that runs out of time is disconnected, since it can't be
+///   stopped from the coordinator, so test cases left waiting once every
+///   worker process is gone are run by the next worker process to connect.
+Report runCoordinatedTests(
+  Environment                    &environment,
+  std::vector<ScheduledTest>     &schedule   ,
+  const char                     *address    ,
+  std::function<void(RunState &)> state
+);
+
+/// Connect to a coordinator and run the test cases that it hands out until it
+/// finishes.
+/// \param[in] address
+///   The address of the coordinator, as given to `runCoordinatedTests`.
+/// \returns
+///   The exit status of the worker process.
+/// \remarks
+///   A test suite is set up the first time that the worker process runs one of
+///   its test cases, and torn down once the coordinator finishes.
+int runCoordinatedWorker(const char *address);
+
+
+
+END_NAMESPACE_EXPECT
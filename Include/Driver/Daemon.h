@@ -0,0 +1,70 @@
+// ===--- Daemon.h ----------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for serving test runs to clients over a Unix socket.         //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include "TestState.h"
+#include <Suite/Suite.h>
+#include <string>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// The kinds of message sent by a test daemon to its client.
+enum class DaemonMessage {
+  Output  , //< Text printed by the command line test driver.
+  Event   , //< A run state that the test run went through.
+  Finished, //< The test run finished, with the exit status of the driver.
+};
+
+/// Send text printed by the command line test driver to a client.
+/// \param[in] socket
+///   The client connection.
+/// \param[in] text
+///   The printed text.
+void sendDaemonOutput(int socket, const std::string &text);
+
+/// Send a run state to a client.
+/// \param[in] socket
+///   The client connection.
+/// \param[in] state
+///   The run state.
+/// \param[in] suite
+///   The test suite that the run state belongs to.
+void sendDaemonEvent(int socket, RunState &state, Suite &suite);
+
+/// Serve command line test runs until the process is killed.
+/// \param[in] path
+///   The path of the Unix socket to listen on.
+///   Any existing socket at the path is replaced.
+/// \param[in] executable
+///   The path of the test executable, passed to each run as `argv[0]`.
+/// \returns
+///   The exit status of the process if the socket can't be served.
+/// \remarks
+///   Each connection sends a single message with the command line arguments
+///   of a run, and receives `DaemonMessage` messages until the run finishes.
+///   Runs are served one at a time.
+int serveCommandLineTests(const char *path, const char *executable);
+
+/// Run a command line test run on a test daemon and print its output.
+/// \param[in] argc
+///   The standard `argc` command line argument.
+/// \param[in] argv
+///   The standard `argv` command line argument, with the path of the daemon
+///   socket followed by the command line arguments of the run.
+/// \returns
+///   The exit status of the run.
+int runTestClient(int argc, char *argv[]);
+
+
+
+END_NAMESPACE_EXPECT
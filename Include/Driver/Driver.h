@@ -11,6 +11,7 @@
 #pragma once
 #include <Expect Common.h>
 #include "TestState.h"
+#include "Schedule.h"
 #include <Global/Environment.h>
 #include <Suite/Suite.h>
 #include <functional>
@@ -38,17 +39,106 @@ struct Report {
   /// The number of test cases in the test run that failed at least one
   /// assertion check.
   size_t totalFailed;
+  /// The number of failed test cases in the test run that exceeded their time
+  /// limit.
+  size_t totalTimedOut = 0;
+  /// The number of failed test cases in the test run that passed at least one
+  /// of their reruns.
+  size_t totalFlaky = 0;
+  /// The number of failed test cases in the test run that failed all of their
+  /// reruns.
+  size_t totalDeterministic = 0;
+  /// The total time spent forking and reaping the processes that isolated
+  /// test cases ran in, in nanoseconds.
+  long long isolationTime = 0;
 };
 
+/// Run a single test case.
+/// \param[inout] environment
+///   The test environment to run the test case in.
+///   Reset once the test case finishes.
+/// \param[in] test
+///   The test case to run.
+/// \returns
+///   The result of the test case.
+TestResult runTest(
+  Environment &environment,
+  Test        &test
+);
+
+/// Run asynchronous test cases interleaved on an event loop on the calling
+/// thread.
+/// \param[in] environment
+///   The test environment to run the test cases in.
+///   Each test case runs in its own copy of the environment.
+/// \param[in] tests
+///   The asynchronous test cases to run.
+/// \returns
+///   The result of each test case.
+/// \remarks
+///   A test case that runs out of time is abandoned where it is waiting, and
+///   a test case that is left waiting on nothing once the event loop runs dry
+///   fails.
+std::vector<TestResult> runAsyncTests(
+  Environment         &environment,
+  std::vector<Test *> &tests
+);
+
+/// Run all enabled test cases on the calling thread.
+/// \param[inout] environment
+///   The test environment to run the test cases in.
+/// \param[in] state
+///   The run state handler.
+Report runTests(
+  Environment                    &environment,
+  std::function<void(RunState &)> state
+);
+
+/// Run all enabled test cases on a pool of worker threads.
+/// \param[in] environment
+///   The test environment to run the test cases in.
+///   Each worker runs its test cases in its own copy of the environment.
+/// \param[in] jobs
+///   The number of worker threads to run the test cases on.
+///   `0` uses one worker per hardware thread and `1` runs all test cases on
+///   the calling thread.
+/// \param[in] state
+///   The run state handler.
+///   Always called from the calling thread, in the same order as it would be
+///   for a run on a single thread.
 Report runTests(
   Environment                    &environment,
+  size_t                          jobs       ,
+  std::function<void(RunState &)> state
+);
+
+/// Run a schedule of test cases on a pool of worker threads.
+/// \param[in] environment
+///   The test environment to run the test cases in.
+///   Each worker runs its test cases in its own copy of the environment.
+/// \param[in] schedule
+///   The test cases to run.
+///   The test cases of a test suite must be listed next to each other.
+/// \param[in] jobs
+///   The number of worker threads to run the test cases on.
+///   `0` uses one worker per hardware thread and `1` runs all test cases on
+///   the calling thread.
+/// \param[in] state
+///   The run state handler.
+///   Always called from the calling thread, in schedule order.
+Report runTests(
+  Environment                    &environment,
+  std::vector<ScheduledTest>     &schedule   ,
+  size_t                          jobs       ,
   std::function<void(RunState &)> state
 );
 
 struct RunTests {
   Environment &environment;
   
-  RunTests(Environment &environment);
+  size_t jobs;
+  
+  RunTests(Environment &environment, size_t jobs = 1);
   
   Report operator << (std::function<void(RunState &)> state);
 };
@@ -66,3 +156,11 @@ END_NAMESPACE_EXPECT
 #define RUN_ENABLED_TESTS(environment, state) \
   ::NAMESPACE_EXPECT RunTests(environment) << \
     [&](::NAMESPACE_EXPECT RunState &state) -> void
+
+/// Run all enabled test cases on a pool of worker threads.
+/// \param jobs
+///   The number of worker threads to run the test cases on.
+/// \sa RUN_ENABLED_TESTS
+#define RUN_ENABLED_TESTS_PARALLEL(environment, jobs, state) \
+  ::NAMESPACE_EXPECT RunTests(environment, jobs) << \
+    [&](::NAMESPACE_EXPECT RunState &state) -> void
@@ -0,0 +1,125 @@
+// ===--- EventLoop.h -------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for the event loop that asynchronous test cases run on.      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <unordered_map>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// A single-threaded event loop that asynchronous test cases wait on.
+/// \remarks
+///   Built on `epoll` and `timerfd` on Linux, and on `poll` on other Unix
+///   platforms.
+///   Elsewhere only timers are supported, and files are always reported as
+///   ready.
+struct EventLoop {
+  /// A registered wait.
+  struct Wait {
+    /// The owner that the wait was registered for.
+    size_t owner;
+    /// Called once the wait is over.
+    std::function<void()> callback;
+  };
+  
+  /// The waits registered on a file.
+  struct FileWaits {
+    /// The waits for the file to become readable.
+    std::deque<Wait> read { };
+    /// The waits for the file to become writable.
+    std::deque<Wait> write { };
+    /// The events that the file is registered with the poller for.
+    int events = 0;
+  };
+  
+  /// The owner that new waits are registered for.
+  /// \remarks
+  ///   Set to the owner of each wait while its callback runs, so that the waits
+  ///   that an asynchronous test case registers while it runs stay its own.
+  size_t owner = 0;
+  
+  /// The waits registered on each file.
+  std::unordered_map<int, FileWaits> files { };
+  
+  /// The registered timers, by when they expire.
+  std::multimap<std::chrono::steady_clock::time_point, Wait> timers { };
+  
+  /// The waits that are over and have yet to be called back.
+  std::deque<Wait> ready { };
+  
+  /// The `epoll` instance on Linux, otherwise `-1`.
+  int poller = -1;
+  
+  /// The `timerfd` that wakes up the `epoll` instance on Linux, otherwise
+  /// `-1`.
+  int timer = -1;
+  
+  EventLoop();
+  ~EventLoop();
+  EventLoop(const EventLoop &) = delete;
+  EventLoop &operator = (const EventLoop &) = delete;
+  
+  /// Wait for a file to become readable.
+  /// \param[in] file
+  ///   The file descriptor to wait on.
+  /// \param[in] callback
+  ///   Called once the file is readable, has been closed, or has an error.
+  void waitReadable(int file, std::function<void()> callback);
+  
+  /// Wait for a file to become writable.
+  /// \param[in] file
+  ///   The file descriptor to wait on.
+  /// \param[in] callback
+  ///   Called once the file is writable, has been closed, or has an error.
+  void waitWritable(int file, std::function<void()> callback);
+  
+  /// Wait for an amount of time to pass.
+  /// \param[in] nanoseconds
+  ///   The time to wait, in nanoseconds.
+  /// \param[in] callback
+  ///   Called once the time has passed.
+  void waitFor(long long nanoseconds, std::function<void()> callback);
+  
+  /// Drop all of the waits registered for an owner, without calling them back.
+  /// \param[in] owner
+  ///   The owner of the waits.
+  void cancel(size_t owner);
+  
+  /// Wait for at least one wait to be over and call back every wait that is
+  /// over.
+  /// \returns
+  ///   Whether or not anything was waiting.
+  bool step();
+  
+  /// Run until nothing is waiting.
+  void run();
+  
+  /// Get the event loop running on the calling thread.
+  /// \returns
+  ///   The event loop, or `nullptr` if none is running.
+  static EventLoop *&current();
+
+private:
+  /// Update the events that a file is registered with the poller for.
+  void update(int file);
+  
+  /// Call back every wait that is over.
+  void dispatch();
+};
+
+
+
+END_NAMESPACE_EXPECT
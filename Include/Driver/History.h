@@ -0,0 +1,95 @@
+// ===--- History.h ---------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for recording how test cases went in previous runs.         //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include "Schedule.h"
+#include <Suite/Suite.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// A record of how long test cases took to run in previous test runs, and
+/// whether or not they failed.
+/// \remarks
+///   Stored as a text file with one test case per line, each line holding the
+///   time in nanoseconds, the test suite name, and the test case name,
+///   separated by tabs.
+///   The lines of test cases that failed the last time they were run start
+///   with a `!`.
+struct History {
+  /// The last recorded time of each test case, in nanoseconds, keyed by the
+  /// test suite and test case name.
+  std::unordered_map<std::string, long long> times { };
+  
+  /// The test cases that failed the last time they were run, keyed by the
+  /// test suite and test case name.
+  std::unordered_set<std::string> failures { };
+  
+  /// Load the recorded times from a history file.
+  /// \param[in] path
+  ///   The path of the history file.
+  /// \returns
+  ///   Whether or not the history file could be read.
+  bool load(const char *path);
+  
+  /// Save the recorded times to a history file.
+  /// \param[in] path
+  ///   The path of the history file.
+  /// \returns
+  ///   Whether or not the history file could be written.
+  bool save(const char *path);
+  
+  /// Get the recorded time of a test case.
+  /// \param[in] suite
+  ///   The test suite that the test case is in.
+  /// \param[in] test
+  ///   The test case.
+  /// \returns
+  ///   The recorded time, in nanoseconds, or `-1` if there is none.
+  long long time(Suite &suite, Test &test);
+  
+  /// Get whether or not a test case failed the last time it was run.
+  /// \param[in] suite
+  ///   The test suite that the test case is in.
+  /// \param[in] test
+  ///   The test case.
+  bool failed(Suite &suite, Test &test);
+  
+  /// Record the time and outcome of a test case.
+  /// \param[in] suite
+  ///   The test suite that the test case is in.
+  /// \param[in] test
+  ///   The test case.
+  /// \param[in] time
+  ///   The time the test case took to run, in nanoseconds.
+  /// \param[in] failed
+  ///   Whether or not the test case failed.
+  void record(Suite &suite, Test &test, long long time, bool failed = false);
+  
+  /// Set the expected time of each scheduled test case from its recorded time.
+  /// \param[inout] schedule
+  ///   The scheduled test cases.
+  void estimate(std::vector<ScheduledTest> &schedule);
+  
+  /// Mark the scheduled test cases that failed the last time they were run
+  /// to be run first.
+  /// \param[inout] schedule
+  ///   The scheduled test cases.
+  void prioritize(std::vector<ScheduledTest> &schedule);
+};
+
+
+
+END_NAMESPACE_EXPECT
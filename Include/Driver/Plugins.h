@@ -0,0 +1,75 @@
+// ===--- Plugins.h ---------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for loading test suites from plugins on demand.              //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include <unordered_map>
+#include <vector>
+#include <string>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// A list of the test suites held by plugins, shared objects that register
+/// their test suites when they are loaded.
+/// \remarks
+///   Stored as a text file with one test suite per line, each line holding the
+///   test suite name and the path of its plugin, separated by a tab.
+///   Relative plugin paths are relative to the directory of the manifest.
+///   Plugins are built without the library, whose symbols they take from the
+///   executable that loads them, so that they register their test suites with
+///   it.
+struct PluginManifest {
+  /// The path of the plugin holding each test suite, keyed by the test suite
+  /// name.
+  std::unordered_map<std::string, std::string> suites { };
+  
+  /// Every plugin in the manifest, in the order in which they are first
+  /// listed.
+  std::vector<std::string> plugins { };
+  
+  /// Whether or not each plugin has been loaded.
+  std::vector<bool> loaded { };
+  
+  /// The reason that the last plugin failed to load.
+  std::string error { };
+  
+  /// Load a plugin manifest.
+  /// \param[in] path
+  ///   The path of the manifest file.
+  /// \returns
+  ///   Whether or not the manifest file could be read.
+  bool load(const char *path);
+  
+  /// Load the plugin holding a test suite, unless it is already loaded.
+  /// \param[in] name
+  ///   The name of the test suite.
+  /// \returns
+  ///   Whether or not a plugin was loaded.
+  bool loadSuite(const char *name);
+  
+  /// Load every plugin that isn't already loaded.
+  /// \returns
+  ///   Whether or not every plugin could be loaded.
+  bool loadAll();
+
+private:
+  /// Load a plugin and index the test suites that it registers.
+  /// \param[in] plugin
+  ///   The index of the plugin.
+  /// \returns
+  ///   Whether or not the plugin could be loaded.
+  bool loadPlugin(size_t plugin);
+};
+
+
+
+END_NAMESPACE_EXPECT
@@ -0,0 +1,95 @@
+// ===--- ProcessDriver.h ---------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The test driver used when running tests in isolated worker processes.      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include "Driver.h"
+
+START_NAMESPACE_EXPECT
+
+
+
+/// Run a schedule of test cases on a pool of forked worker processes.
+/// \param[in] environment
+///   The test environment to run the test cases in.
+///   Each worker process runs its test cases in its own copy of the
+///   environment.
+/// \param[in] schedule
+///   The test cases to run.
+///   The test cases of a test suite must be listed next to each other.
+/// \param[in] processes
+///   The number of worker processes to run the test cases on.
+///   `0` uses one worker per hardware thread.
+/// \param[in] state
+///   The run state handler.
+///   Always called from the calling process, in schedule order.
+/// \param[in] isolate
+///   Whether or not each worker process should run every test case in a fresh
+///   child process forked from itself, after setting up the test suite, so
+///   that test cases can't leave any state behind for each other.
+///   The time this adds is reported in `Report::isolationTime`.
+/// \remarks
+///   The worker processes are forked from the calling process, so this must
+///   only be called once all test suites have been registered.
+///   A test suite is set up in every worker process that runs any of its test
+///   cases, and torn down when that worker process exits.
+///   A worker process that crashes or is killed while running a test case
+///   fails that test case with the signal that ended it and is replaced by a
+///   new worker process.
+///   On platforms without `fork`, the test cases are run on worker threads
+///   instead.
+Report runForkedTests(
+  Environment                    &environment,
+  std::vector<ScheduledTest>     &schedule   ,
+  size_t                          processes  ,
+  std::function<void(RunState &)> state      ,
+  bool                            isolate = false
+);
+
+/// Run a schedule of test cases, rerunning every test case that fails to tell
+/// a flaky test case from one that fails deterministically.
+/// \param[in] environment
+///   The test environment to rerun the failed test cases in.
+/// \param[in] schedule
+///   The test cases to run.
+///   The test cases of a test suite must be listed next to each other.
+/// \param[in] reruns
+///   The number of times to rerun each failed test case.
+/// \param[in] state
+///   The run state handler of the test run.
+/// \param[in] rerun
+///   The handler of the reruns of each failed test case, given the test suite,
+///   the test case, and the number of its reruns that passed.
+///   A rerun test case that passed any of its reruns is flaky, while one that
+///   failed all of them fails deterministically.
+/// \param[in] run
+///   Runs the test cases, such as with `runTests`.
+/// \returns
+///   A report of the test run, counting the flaky and deterministically failing
+///   test cases.
+/// \remarks
+///   The failed test cases are only rerun once the test run has returned, so
+///   that no other test case is running when the workers for the reruns are
+///   forked, and the time limits of the test run aren't held up.
+///   The reruns of a failed test case run concurrently, each in its own worker
+///   process forked by `runForkedTests`, which sets up the test suite again.
+Report rerunFailures(
+  Environment                    &environment,
+  std::vector<ScheduledTest>     &schedule   ,
+  size_t                          reruns     ,
+  std::function<void(RunState &)> state      ,
+  std::function<void(Suite &, Test &, size_t)> rerun,
+  std::function<Report(
+    std::vector<ScheduledTest> &, std::function<void(RunState &)>)> run
+);
+
+
+
+END_NAMESPACE_EXPECT
@@ -0,0 +1,158 @@
+// ===--- Schedule.h --------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for scheduling test cases and collecting their results.      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include "TestState.h"
+#include <Suite/Suite.h>
+#include <vector>
+#include <functional>
+#include <stdint.h>
+
+START_NAMESPACE_EXPECT
+
+
+
+struct Report;
+
+/// A test case scheduled to be run.
+struct ScheduledTest {
+  /// The test suite that the test case is in.
+  Suite *suite;
+  
+  /// The test case to run.
+  Test *test;
+  
+  /// How long the test case is expected to take to run, in nanoseconds, or
+  /// `-1` if unknown.
+  long long time;
+  
+  /// Whether or not the test case should be handed out to workers before the
+  /// rest, such as because it failed in the previous run.
+  bool first;
+};
+
+/// Get a list of all enabled test cases in the order in which they were
+/// registered.
+/// \remarks
+///   The test cases of a test suite are always listed next to each other.
+std::vector<ScheduledTest> enabledTests();
+
+/// Shuffle the order of the test suites in a schedule, and of the test cases
+/// within each test suite.
+/// \param[inout] schedule
+///   The scheduled test cases.
+///   The test cases of a test suite must be listed next to each other, and
+///   still are once shuffled.
+/// \param[in] seed
+///   The seed to shuffle with.
+///   The same seed always gives the same order on every platform.
+/// \remarks
+///   Also forgets the expected times of the test cases and which ones to run
+///   first, so that the order in which they are handed out to workers only
+///   depends on the seed and the number of workers.
+void shuffleTests(std::vector<ScheduledTest> &schedule, uint64_t seed);
+
+/// Get the order in which to hand scheduled test cases out to workers.
+/// \param[in] schedule
+///   The scheduled test cases.
+/// \returns
+///   The indices of the scheduled test cases to run first, followed by the
+///   rest, each with the test cases with a known expected time longest first
+///   followed by the rest in schedule order.
+std::vector<size_t> dispatchOrder(const std::vector<ScheduledTest> &schedule);
+
+/// Get the mean expected time of the scheduled test cases with a known
+/// expected time.
+/// \param[in] schedule
+///   The scheduled test cases.
+/// \returns
+///   The mean expected time, in nanoseconds, or `1` if no test case has a
+///   known expected time.
+long long expectedTime(const std::vector<ScheduledTest> &schedule);
+
+
+
+/// Collects the results of scheduled test cases, which may finish in any
+/// order, and reports them in schedule order.
+/// \remarks
+///   The test cases of a test suite must be listed next to each other in the
+///   schedule.
+struct Collector {
+  /// The scheduled test cases.
+  std::vector<ScheduledTest> &schedule;
+  
+  /// The run state handler to report to.
+  std::function<void(RunState &)> state;
+  
+  /// The results of finished test cases that have not yet been reported.
+  std::vector<TestResult> results;
+  
+  /// Whether or not each scheduled test case has finished.
+  std::vector<bool> finished;
+  
+  /// The 1-based index of each scheduled test case within its test suite.
+  std::vector<size_t> index;
+  
+  /// The number of scheduled test cases in the test suite of each scheduled
+  /// test case.
+  std::vector<size_t> count;
+  
+  /// The next scheduled test case to report.
+  size_t next = 0;
+  
+  /// Whether or not the next scheduled test case has been reported as running.
+  bool nextStarted = false;
+  
+  /// The number of successful test cases in the current test suite.
+  size_t suiteSuccessful = 0;
+  
+  /// The number of reported test cases.
+  size_t total = 0;
+  
+  /// The number of reported test cases that were successful.
+  size_t totalSuccessful = 0;
+  
+  /// The number of reported test cases that exceeded their time limit.
+  size_t totalTimedOut = 0;
+  
+  /// Create a result collector.
+  /// \param[in] schedule
+  ///   The scheduled test cases.
+  /// \param[in] state
+  ///   The run state handler to report to.
+  Collector(
+    std::vector<ScheduledTest>     &schedule,
+    std::function<void(RunState &)> state
+  );
+  
+  /// Report that a scheduled test case is about to be run.
+  /// \param[in] test
+  ///   The index of the test case in the schedule.
+  /// \remarks
+  ///   Only reported immediately if all previously scheduled test cases have
+  ///   been reported, otherwise it will be reported along with its result.
+  void start(size_t test);
+  
+  /// Record the result of a scheduled test case and report all results that
+  /// are now available in schedule order.
+  /// \param[in] test
+  ///   The index of the test case in the schedule.
+  /// \param[in] result
+  ///   The result of the test case.
+  void finish(size_t test, TestResult result);
+  
+  /// Get a report of all of the reported test cases.
+  Report report();
+};
+
+
+
+END_NAMESPACE_EXPECT
@@ -0,0 +1,58 @@
+// ===--- Shard.h ------------------------------------------------ C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for splitting a test run across several machines.           //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include "Schedule.h"
+#include <vector>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// Get the shard that a test case belongs to from a stable hash of its test
+/// suite and test case names.
+/// \param[in] suite
+///   The test suite that the test case is in.
+/// \param[in] test
+///   The test case.
+/// \param[in] count
+///   The total number of shards.
+/// \returns
+///   The index of the shard that the test case belongs to.
+size_t shardOf(Suite &suite, Test &test, size_t count);
+
+/// Assign each scheduled test case to a shard.
+/// \param[in] schedule
+///   The scheduled test cases.
+/// \param[in] count
+///   The total number of shards.
+/// \param[in] balance
+///   Whether or not to pack the test cases with a known expected time into the
+///   shards so that each shard is expected to take about as long as the
+///   others.
+///   Test cases without a known expected time are always assigned by
+///   `shardOf`.
+/// \returns
+///   The index of the shard of each scheduled test case.
+/// \remarks
+///   The assignment only depends on the scheduled test cases and their
+///   expected times, so every machine computes the same assignment as long as
+///   they select the same test cases and, when balancing, share the same
+///   history.
+std::vector<size_t> assignShards(
+  const std::vector<ScheduledTest> &schedule,
+  size_t                            count   ,
+  bool                              balance
+);
+
+
+
+END_NAMESPACE_EXPECT
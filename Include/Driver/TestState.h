@@ -16,6 +16,24 @@ START_NAMESPACE_EXPECT
 
 
 
+/// The outcome of running a single test case.
+struct TestResult {
+  /// Whether or not the test case passed all assertion checks.
+  bool success = true;
+  
+  /// A list of all the assertion failures in the test case.
+  std::vector<Failure> failures { };
+  
+  /// A list of all micro benchmark results that were run in the test case.
+  std::vector<BenchmarkResult> benchmarks { };
+  
+  /// The wall time that the test case took to run, in nanoseconds.
+  long long time = 0;
+  
+  /// Whether or not the test case was stopped for exceeding its time limit.
+  bool timedOut = false;
+};
+
 /// The state of an in-progress test run.
 struct RunState {
   /// The state tag.
@@ -73,7 +91,11 @@ struct TestSuccess : RunState {
   /// A list of all micro benchmark results that were run in the test case.
   std::vector<BenchmarkResult> &benchmarks;
   
-  TestSuccess(Test &test, std::vector<BenchmarkResult> &benchmarks);
+  /// The wall time that the test case took to run, in nanoseconds.
+  long long time;
+  
+  TestSuccess(
+    Test &test, std::vector<BenchmarkResult> &benchmarks, long long time = 0);
 };
 
 /// A test case failed in running.
@@ -84,7 +106,13 @@ struct TestFailed : RunState {
   /// A list of all the assertion failures in the test case.
   std::vector<Failure> &failures;
   
-  TestFailed(Test &test, std::vector<Failure> &failures);
+  /// The wall time that the test case took to run, in nanoseconds.
+  long long time;
+  
+  /// Whether or not the test case was stopped for exceeding its time limit.
+  bool timedOut = false;
+  
+  TestFailed(Test &test, std::vector<Failure> &failures, long long time = 0);
 };
 
 
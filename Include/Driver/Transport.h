@@ -0,0 +1,129 @@
+// ===--- Transport.h -------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for sending test results between processes.                  //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include "TestState.h"
+#include <string>
+#include <stdint.h>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// Append an integer to a message.
+/// \param[inout] message
+///   The message to append to.
+/// \param[in] value
+///   The integer to append.
+void writeInteger(std::string &message, uint64_t value);
+
+/// Append a floating point number to a message.
+/// \param[inout] message
+///   The message to append to.
+/// \param[in] value
+///   The number to append.
+void writeDouble(std::string &message, double value);
+
+/// Append a string to a message.
+/// \param[inout] message
+///   The message to append to.
+/// \param[in] value
+///   The string to append.
+void writeString(std::string &message, const std::string &value);
+
+/// Append a test result to a message.
+/// \param[inout] message
+///   The message to append to.
+/// \param[in] result
+///   The test result to append.
+void writeResult(std::string &message, const TestResult &result);
+
+/// Read an integer from a message.
+/// \param[inout] data
+///   The current position in the message.
+///   Moved past the integer that was read.
+/// \param[in] end
+///   The end of the message.
+/// \param[out] value
+///   The integer that was read.
+/// \returns
+///   Whether or not an integer could be read.
+bool readInteger(const char *&data, const char *end, uint64_t &value);
+
+/// Read a floating point number from a message.
+/// \param[inout] data
+///   The current position in the message.
+///   Moved past the number that was read.
+/// \param[in] end
+///   The end of the message.
+/// \param[out] value
+///   The number that was read.
+/// \returns
+///   Whether or not a number could be read.
+bool readDouble(const char *&data, const char *end, double &value);
+
+/// Read a string from a message.
+/// \param[inout] data
+///   The current position in the message.
+///   Moved past the string that was read.
+/// \param[in] end
+///   The end of the message.
+/// \param[out] value
+///   The string that was read.
+/// \returns
+///   Whether or not a string could be read.
+bool readString(const char *&data, const char *end, std::string &value);
+
+/// Read a test result from a message.
+/// \param[inout] data
+///   The current position in the message.
+///   Moved past the test result that was read.
+/// \param[in] end
+///   The end of the message.
+/// \param[out] result
+///   The test result that was read.
+/// \returns
+///   Whether or not a test result could be read.
+bool readResult(const char *&data, const char *end, TestResult &result);
+
+/// Send a complete message over a file descriptor.
+/// \param[in] file
+///   The file descriptor to write to.
+/// \param[in] message
+///   The message to send.
+/// \returns
+///   Whether or not the whole message was sent.
+bool sendMessage(int file, const std::string &message);
+
+/// Receive a complete message sent with `sendMessage` from a file descriptor.
+/// \param[in] file
+///   The file descriptor to read from.
+/// \param[out] message
+///   The message that was received.
+/// \returns
+///   Whether or not a whole message was received.
+bool receiveMessage(int file, std::string &message);
+
+/// Make way for a server to listen on a Unix socket path, removing a stale
+/// socket left behind by a server that is no longer running.
+/// \param[in] path
+///   The path of the Unix socket.
+/// \returns
+///   Whether or not the path is free to bind to.
+/// \remarks
+///   Anything other than a stale socket, such as a regular file or a socket
+///   that a server is still listening on, is left alone and reported to the
+///   standard error.
+bool clearSocketPath(const char *path);
+
+
+
+END_NAMESPACE_EXPECT
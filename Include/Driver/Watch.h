@@ -0,0 +1,90 @@
+// ===--- Watch.h ------------------------------------------------ C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for watching the test executable and sources for changes.    //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// Watches the test executable, and optionally source directories, for
+/// changes.
+/// \remarks
+///   Built on `inotify`, so only supported on Linux.
+///   Changes are queued from the moment that the watcher is opened, so a
+///   change made while tests are running is noticed once they finish.
+struct Watcher {
+  /// The `inotify` instance, or `-1` if the watcher isn't open.
+  int file = -1;
+  
+  /// The watch on the directory of the test executable.
+  int executableWatch = -1;
+  
+  /// The file name of the test executable within its directory.
+  std::string executableName = "";
+  
+  /// The absolute path of each watched directory, keyed by its watch.
+  std::unordered_map<int, std::string> watched { };
+  
+  /// The absolute paths of the files and directories whose changes don't
+  /// count, such as those written by the run itself.
+  std::vector<std::string> ignored { };
+  
+  /// Start watching for changes.
+  /// \param[in] executable
+  ///   The path of the test executable.
+  ///   Its directory is watched, so that an executable replaced by a rebuild
+  ///   is still noticed.
+  /// \param[in] directories
+  ///   The source directories to watch, along with their subdirectories.
+  /// \param[in] ignore
+  ///   The files and directories whose changes don't count, such as the test
+  ///   history, along with the temporary files written next to them.
+  /// \returns
+  ///   Whether or not watching is supported and the test executable could be
+  ///   watched.
+  bool open(
+    const char                     *executable ,
+    const std::vector<std::string> &directories,
+    const std::vector<std::string> &ignore = { }
+  );
+  
+  /// Stop watching for changes.
+  void close();
+  
+  /// Wait for something to change, and then for the changes to settle.
+  /// \param[in] quiet
+  ///   How long nothing must change for after a change, in milliseconds, so
+  ///   that a burst of changes, such as from a rebuild, counts as one.
+  /// \returns
+  ///   Whether or not something changed, or `false` if the watcher failed.
+  bool wait(long long quiet);
+};
+
+/// Replace the running test executable with a fresh run of the same command
+/// line, running the test cases that failed last time first.
+/// \param[in] argc
+///   The number of command line arguments.
+/// \param[in] argv
+///   The command line arguments, starting with the path of the test
+///   executable.
+/// \remarks
+///   Sets `EXPECT_WATCH_RERUN` in the environment of the fresh run.
+///   Only returns if the test executable couldn't be run, such as while it is
+///   being rebuilt.
+void rerunTests(int argc, char *argv[]);
+
+
+
+END_NAMESPACE_EXPECT
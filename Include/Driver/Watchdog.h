@@ -0,0 +1,50 @@
+// ===--- Watchdog.h --------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for diagnosing test cases that exceed their time limit.      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include <Global/Environment.h>
+#include <vector>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// Get the identifier of the calling thread, as used by `captureStacks`.
+/// \returns
+///   The kernel thread identifier on Linux, otherwise `0`.
+long long currentThread();
+
+/// Capture the call stack of every thread in the process.
+/// \param[in] highlight
+///   The identifier of a thread to mark as having timed out.
+/// \returns
+///   A failure describing the call stack of each thread, or nothing if call
+///   stacks can't be captured on this platform.
+/// \remarks
+///   Only supported on Linux with glibc.
+std::vector<Failure> captureStacks(long long highlight);
+
+/// Install a signal handler that writes the call stack of the interrupted
+/// thread to a file descriptor.
+/// \param[in] file
+///   The file descriptor to write the call stack to.
+/// \remarks
+///   Used by forked worker processes so that the driver process can find out
+///   where a timed out test case is stuck before killing it.
+///   Only supported on Linux with glibc.
+void installStackDump(int file);
+
+/// The signal used to request the call stack of a thread.
+int stackSignal();
+
+
+
+END_NAMESPACE_EXPECT
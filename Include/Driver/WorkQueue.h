@@ -0,0 +1,68 @@
+// ===--- WorkQueue.h -------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for a work-stealing queue shared by a set of workers.        //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <memory>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// A set of double-ended work queues, one per worker, that allows idle workers
+/// to steal work from busy ones.
+/// \remarks
+///   A worker takes work from the front of its own queue and steals work from
+///   the back of the queues of the other workers.
+struct WorkQueue {
+  /// The work queue of a single worker.
+  struct Deque {
+    /// The lock guarding the queue.
+    std::mutex lock;
+    
+    /// The queued work items.
+    std::deque<size_t> items;
+  };
+  
+  /// The work queues of each of the workers.
+  std::vector<std::unique_ptr<Deque>> deques;
+  
+  /// Whether or not workers with an empty queue steal from the other workers.
+  bool stealing = true;
+  
+  /// Create a set of empty work queues.
+  /// \param[in] workers
+  ///   The number of workers.
+  WorkQueue(size_t workers);
+  
+  /// Add a work item to the back of a worker's queue.
+  /// \param[in] worker
+  ///   The worker whose queue to add to.
+  /// \param[in] item
+  ///   The work item to add.
+  void push(size_t worker, size_t item);
+  
+  /// Take the next work item for a worker, stealing from the other workers if
+  /// its own queue is empty and stealing is enabled.
+  /// \param[in] worker
+  ///   The worker taking work.
+  /// \param[out] item
+  ///   The work item taken.
+  /// \returns
+  ///   Whether or not there was any work left to take.
+  bool pop(size_t worker, size_t &item);
+};
+
+
+
+END_NAMESPACE_EXPECT
@@ -28,6 +28,14 @@ struct Failure {
   std::string message;
 };
 
+/// The value of a parameter of a benchmark family.
+struct BenchmarkParameter {
+  /// The name of the parameter.
+  std::string name;
+  /// The value of the parameter.
+  long long value;
+};
+
 /// The result of a benchmarking run.
 struct BenchmarkResult {
   /// The line number of the benchmark that was run.
@@ -37,21 +45,86 @@ struct BenchmarkResult {
   /// The total elapsed time of the benchmark.
   long long totalTime;
   /// The mean time that a benchmark cycle took, in nanoseconds.
-  long long meanTime;
+  double meanTime;
   /// The median time that a benchmark cycle took, in nanoseconds.
-  long long medianTime;
+  double medianTime;
   /// The minimum time that a benchmark cycle took, in nanoseconds.
-  long long minTime;
+  double minTime;
   /// The maximum time that a benchmark cycle took, in nanoseconds.
-  long long maxTime;
+  double maxTime;
   /// The first quartile of the time that a benchmark cycle took,
   /// in nanoseconds.
-  long long q1Time;
+  double q1Time;
   /// The third quartile of the time that a benchmark cycle took,
   /// in nanoseconds.
-  long long q3Time;
-  /// The execution times of each iteration, in nanoseconds.
-  std::vector<long long> times;
+  double q3Time;
+  /// The time that a benchmark cycle took in each iteration, in nanoseconds.
+  std::vector<double> times;
+  /// The relative half width of the 95% confidence interval of the median
+  /// time, such as `0.01` for a median within 1%.
+  double precision;
+  /// The number of benchmark cycles run in each iteration, which the time of
+  /// the iteration is divided between, after taking out the cost of reading
+  /// the clock.
+  size_t batch;
+  /// The mean number of CPU cycles that a benchmark cycle took, or `-1` if
+  /// hardware performance counters weren't collected.
+  double cycles;
+  /// The mean number of instructions retired in a benchmark cycle, or `-1` if
+  /// not collected.
+  double instructions;
+  /// The mean number of mispredicted branches in a benchmark cycle, or `-1` if
+  /// not collected.
+  double branchMisses;
+  /// The mean number of level 1 data cache read misses in a benchmark cycle,
+  /// or `-1` if not collected.
+  double l1dMisses;
+  /// The mean number of last level cache read misses in a benchmark cycle, or
+  /// `-1` if not collected.
+  double llcMisses;
+  /// The mean number of data TLB read misses in a benchmark cycle, or `-1` if
+  /// not collected.
+  double dtlbMisses;
+  /// The number of instructions retired per CPU cycle, or `-1` if not
+  /// collected.
+  double ipc;
+  /// The mean number of heap allocations made in a benchmark cycle, or `-1`
+  /// if allocations weren't tracked.
+  double allocations;
+  /// The mean number of bytes requested by the heap allocations made in a
+  /// benchmark cycle, or `-1` if allocations weren't tracked.
+  double allocatedBytes;
+  /// The most bytes allocated at once during any iteration, above those
+  /// allocated when the iteration began, or `-1` if allocations weren't
+  /// tracked.
+  long long peakBytes;
+  /// The parameters of the benchmark families that the benchmark was run in,
+  /// outermost first, or none if it wasn't run in a family.
+  std::vector<BenchmarkParameter> parameters;
+};
+
+/// When to stop running the iterations of a benchmark.
+struct BenchmarkSettings {
+  /// The relative half width of the 95% confidence interval of the median
+  /// time to stop at, such as `0.01` for a median within 1%, or `0` to keep
+  /// running until the maximum time or number of iterations.
+  double precision = 0;
+  
+  /// The minimum number of iterations to run.
+  size_t minIterations = 16;
+  
+  /// The maximum number of iterations to run.
+  size_t maxIterations = 1024;
+  
+  /// The minimum total time to run for, in nanoseconds.
+  long long minTime = 0;
+  
+  /// The total time after which to stop, in nanoseconds.
+  long long maxTime = 1000000000;
+  
+  /// Whether or not to collect hardware performance counters, where they are
+  /// available.
+  bool counters = false;
 };
 
 /// A complete testing environment.
@@ -59,6 +132,19 @@ struct Environment {
   /// Whether or not unit test cases should stop after any failed assertion.
   bool stopOnFailure = false;
   
+  /// The time limit of each unit test case, in milliseconds, or `0` for no
+  /// limit.
+  /// \remarks
+  ///   Overridden by a `timeout(ms)` tag on the test case.
+  long long timeout = 0;
+  
+  /// Whether or not each worker thread only runs the test cases dealt to it,
+  /// so that the order in which it runs them only depends on the schedule.
+  bool pinned = false;
+  
+  /// When to stop running the iterations of each benchmark.
+  BenchmarkSettings benchmarking { };
+  
   /// Whether or not the ran unit test was successful.
   bool success = true;
   
@@ -67,6 +153,10 @@ struct Environment {
   
   /// A list of all benchmark results for a unit test run.
   std::vector<BenchmarkResult> benchmarks { };
+  
+  /// The current parameters of the benchmark families being run, outermost
+  /// first.
+  std::vector<BenchmarkParameter> benchmarkParameters { };
 };
 
 
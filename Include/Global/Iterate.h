@@ -16,6 +16,12 @@
 #define _EXPECT_CONCAT_(lhs, rhs) lhs##rhs
 #define _EXPECT_CONCAT(lhs, rhs) _EXPECT_CONCAT_(lhs, rhs)
 
+#if defined(__COUNTER__)
+#define _EXPECT_UNIQUE(name) _EXPECT_CONCAT(name, __COUNTER__)
+#else
+#define _EXPECT_UNIQUE(name) _EXPECT_CONCAT(name, __LINE__)
+#endif
+
 #define _EXPECT_COUNT_( \
   __1, __2, __3, __4, __5, __6, __7, __8, __9, _10, \
   _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, \
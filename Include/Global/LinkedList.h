@@ -0,0 +1,100 @@
+// ===--- LinkedList.h ------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// An intrusive linked list for registering statically allocated objects.     //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include <stddef.h>
+#include <type_traits>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// An intrusive singly linked list of objects with a `next` member, kept in
+/// the order in which they were appended.
+/// \remarks
+///   The list never allocates or owns its objects, so statically allocated
+///   objects can be registered with it during static initialization.
+///   An object can only be in one list at a time.
+/// \tparam T
+///   The type of object in the list.
+/// \tparam pointers
+///   Whether iterating the list yields pointers to the objects instead of
+///   references.
+template <typename T, bool pointers = false>
+struct LinkedList {
+  /// The type yielded when iterating the list.
+  typedef typename std::conditional<pointers, T *, T &>::type Reference;
+  
+  /// An iterator over the objects in a list.
+  struct Iterator {
+    /// The current object, or `nullptr` at the end of the list.
+    T *node;
+    
+    Reference operator * () const {
+      return dereference(node, std::integral_constant<bool, pointers>());
+    }
+    
+    Iterator &operator ++ () {
+      node = node->next;
+      return *this;
+    }
+    
+    bool operator == (const Iterator &other) const {
+      return node == other.node;
+    }
+    
+    bool operator != (const Iterator &other) const {
+      return node != other.node;
+    }
+    
+  private:
+    static T *dereference(T *node, std::true_type) { return node; }
+    static T &dereference(T *node, std::false_type) { return *node; }
+  };
+  
+  /// The first object in the list.
+  T *first = nullptr;
+  
+  /// The last object in the list.
+  T *last = nullptr;
+  
+  /// The number of objects in the list.
+  size_t count = 0;
+  
+  Iterator begin() const { return Iterator { first }; }
+  Iterator end() const { return Iterator { nullptr }; }
+  
+  /// Get the number of objects in the list.
+  size_t size() const { return count; }
+  
+  /// Get whether or not the list is empty.
+  bool empty() const { return count == 0; }
+  
+  /// Get the last object in the list.
+  T &back() const { return *last; }
+  
+  /// Append an object to the end of the list.
+  /// \param[in] node
+  ///   The object to append, which must outlive the list.
+  void append(T &node) {
+    node.next = nullptr;
+    if (last != nullptr)
+      last->next = &node;
+    else
+      first = &node;
+    last = &node;
+    count++;
+  }
+};
+
+
+
+END_NAMESPACE_EXPECT
@@ -0,0 +1,82 @@
+// ===--- Index.h ------------------------------------------------ C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for looking up registered tests by name and tag.             //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include "Suite.h"
+#include <vector>
+#include <unordered_map>
+#include <utility>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// Hashes a C string by its contents.
+struct StringHash {
+  size_t operator () (const char *string) const;
+};
+
+/// Compares C strings by their contents.
+struct StringEqual {
+  bool operator () (const char *lhs, const char *rhs) const;
+};
+
+/// A map keyed by the contents of C strings.
+template <typename T>
+using StringMap = std::unordered_map<const char *, T, StringHash, StringEqual>;
+
+/// An index of test suites, test cases and tags by name.
+struct TestIndex {
+  /// The first test suite with each name, along with its position in the list
+  /// of test suites.
+  StringMap<std::pair<size_t, Suite *>> suites { };
+  
+  /// The first test case with each name, along with the position of its test
+  /// suite in the list of test suites.
+  StringMap<std::pair<size_t, Test *>> tests { };
+  
+  /// Every test case with each tag.
+  StringMap<std::vector<Test *>> tags { };
+  
+  /// Every distinct tag, in the order in which they were first used.
+  std::vector<const char *> tagNames { };
+  
+  /// Index a list of test suites.
+  /// \param[in] suites
+  ///   The test suites to index.
+  ///   Replaces anything previously indexed.
+  void build(const SuiteList &suites);
+  
+  /// Find the test cases selected by a name, as given on the command line.
+  /// \param[in] name
+  ///   The name of a test suite or a test case.
+  /// \param[out] suite
+  ///   The test suite with the name, if it names a test suite.
+  /// \param[out] test
+  ///   The test case with the name, if it names a test case.
+  /// \returns
+  ///   Whether or not anything has the name.
+  /// \remarks
+  ///   When a test suite and a test case share the name, whichever comes
+  ///   first in the list of test suites is selected, preferring the test
+  ///   suite.
+  bool find(const char *name, Suite *&suite, Test *&test) const;
+};
+
+/// Get an index of all registered test suites.
+/// \remarks
+///   Built on first use, so must not be used before all test suites have been
+///   registered.
+TestIndex &testIndex();
+
+
+
+END_NAMESPACE_EXPECT
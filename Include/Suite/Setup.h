@@ -60,11 +60,16 @@
 ///     ...
 ///   }
 ///   ```
+///   Shared values are only constructed right before the test suite is set up
+///   and are destroyed once it has been torn down, so test suites that aren't
+///   run never allocate them and a test suite can be run again in the same
+///   process.
 /// \sa SUITE(name)
 /// \sa SHARED
 #define SETUP \
-  __Shared *shared = new __Shared(); \
-  this->cleanup = [=]() { delete shared; }; \
+  static __Shared *shared = nullptr; \
+  this->prepare = []() { shared = new __Shared(); }; \
+  this->cleanup = []() { delete shared; shared = nullptr; }; \
   this->setup = [=]() -> void
 
 
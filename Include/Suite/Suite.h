@@ -22,7 +22,11 @@ struct Teardown;
 /// A testing suite.
 struct Suite {
   /// A list of all tests in the test suite.
-  std::vector<Test> tests = { };
+  LinkedList<Test> tests { };
+  
+  /// The test suite preparation function, which constructs the shared values
+  /// of the test suite before it is set up.
+  std::function<void()> prepare = nullptr;
   
   /// The test suite setup function
   std::function<void()> setup = nullptr;
@@ -36,6 +40,16 @@ struct Suite {
   /// The name of the test suite.
   const char *name;
   
+  /// The source file that the test suite is defined in, or `nullptr` if it is
+  /// unknown.
+  const char *file = nullptr;
+  
+  /// The line that the test suite is defined on, or `0` if it is unknown.
+  int line = 0;
+  
+  /// The next registered test suite.
+  Suite *next = nullptr;
+  
   
   
   /// Create and register a new test suite instance.
@@ -43,16 +57,38 @@ struct Suite {
   ///   The name of the test suite.
   /// \param[in] suite
   ///   A pointer to the test suite instance.
+  /// \param[in] file
+  ///   The source file that the test suite is defined in.
+  /// \param[in] line
+  ///   The line that the test suite is defined on.
   Suite(
     const char *name ,
-    Suite      *suite
+    Suite      *suite,
+    const char *file = nullptr,
+    int         line = 0
   );
+  
+  /// Create a test suite instance without registering it.
+  /// \param[in] name
+  ///   The name of the test suite.
+  Suite(const char *name);
+  
+  
+  
+  /// Prepare the shared values of the test suite and run its setup, if any.
+  void runSetup();
+  
+  /// Run the test suite teardown and cleanup, if any.
+  void runTeardown();
 };
 
 
 
+/// A list of test suites.
+typedef LinkedList<Suite, true> SuiteList;
+
 /// Get a list of all registered test suites.
-std::vector<Suite *> &suites();
+SuiteList &suites();
 
 
 
@@ -81,4 +117,5 @@ END_NAMESPACE_EXPECT
   static TestSuite##name testSuite##name = { }; \
   } \
   ExpectSuites::TestSuite##name::TestSuite##name() : \
-    NAMESPACE_EXPECT Suite(#name, &ExpectSuites::testSuite##name)
+    NAMESPACE_EXPECT Suite(#name, &ExpectSuites::testSuite##name, __FILE__, \
+      __LINE__)
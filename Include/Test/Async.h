@@ -0,0 +1,247 @@
+// ===--- Async.h ------------------------------------------------ C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The interface for asynchronous unit test cases written as coroutines.      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#pragma once
+#include <Expect Common.h>
+#include "Test.h"
+#include <Driver/EventLoop.h>
+
+// Coroutines need C++20, while the rest of the library only needs C++11
+#if defined(__has_include)
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+#define _EXPECT_COROUTINES 1
+#endif
+#endif
+
+#if _EXPECT_COROUTINES
+#include <chrono>
+#include <coroutine>
+#include <memory>
+
+START_NAMESPACE_EXPECT
+
+
+
+/// The coroutine that an asynchronous unit test case runs as.
+/// \remarks
+///   Doesn't start running until it is started by the test driver.
+struct AsyncTest {
+  struct promise_type {
+    /// Called once the coroutine finishes.
+    std::function<void(std::exception_ptr)> done = nullptr;
+    /// The exception that stopped the coroutine, if any.
+    std::exception_ptr error = nullptr;
+    /// Whether or not the coroutine is still running.
+    std::shared_ptr<bool> alive = nullptr;
+    
+    /// Destroys the coroutine once it finishes, before calling back.
+    struct Finish {
+      bool await_ready() noexcept { return false; }
+      
+      void await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+        promise_type &promise = handle.promise();
+        std::function<void(std::exception_ptr)> done = std::move(promise.done);
+        std::exception_ptr error = promise.error;
+        *promise.alive = false;
+        handle.destroy();
+        if (done != nullptr)
+          done(error);
+      }
+      
+      void await_resume() noexcept { }
+    };
+    
+    AsyncTest get_return_object() {
+      return AsyncTest(
+        std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    
+    std::suspend_always initial_suspend() noexcept { return { }; }
+    
+    Finish final_suspend() noexcept { return { }; }
+    
+    void return_void() { }
+    
+    void unhandled_exception() { error = std::current_exception(); }
+  };
+  
+  /// The coroutine, or `nullptr` once it has been started.
+  std::coroutine_handle<promise_type> handle;
+  
+  explicit AsyncTest(std::coroutine_handle<promise_type> handle)
+    : handle(handle) { }
+  
+  AsyncTest(AsyncTest &&other) : handle(other.handle) {
+    other.handle = nullptr;
+  }
+  
+  AsyncTest(const AsyncTest &) = delete;
+  AsyncTest &operator = (const AsyncTest &) = delete;
+  
+  ~AsyncTest() {
+    if (handle)
+      handle.destroy();
+  }
+  
+  /// Start running the coroutine until it first waits.
+  /// \param[in] done
+  ///   Called once the coroutine finishes, with the exception that stopped it,
+  ///   if any.
+  /// \returns
+  ///   A function that destroys the coroutine if it hasn't finished.
+  std::function<void()> start(std::function<void(std::exception_ptr)> done) {
+    std::coroutine_handle<promise_type> coroutine = handle;
+    std::shared_ptr<bool> alive = std::make_shared<bool>(true);
+    coroutine.promise().done = std::move(done);
+    coroutine.promise().alive = alive;
+    handle = nullptr;
+    coroutine.resume();
+    return [=]() -> void {
+      if (!*alive)
+        return;
+      *alive = false;
+      coroutine.destroy();
+    };
+  }
+};
+
+/// A helper struct to add asynchronous unit tests using the `ASYNC_TEST(...)`
+/// macro.
+struct AddAsync {
+  /// The created test.
+  Test *test;
+  
+  /// Add an asynchronous test driver to the unit test case.
+  /// \param[in] body
+  ///   The coroutine body of the unit test case driver.
+  template<typename Body>
+  void operator, (Body body) {
+    test->async = [=](
+      Environment                            &environment,
+      std::function<void(std::exception_ptr)> done
+    ) -> std::function<void()> {
+      return body(environment).start(std::move(done));
+    };
+  }
+};
+
+/// Waits for a file to become readable on the running event loop.
+struct Readable {
+  /// The file descriptor to wait on.
+  int file;
+  
+  bool await_ready() const noexcept { return false; }
+  
+  void await_suspend(std::coroutine_handle<> handle) const {
+    EventLoop::current()->waitReadable(file, [=]() -> void {
+      handle.resume();
+    });
+  }
+  
+  void await_resume() const noexcept { }
+};
+
+/// Waits for a file to become writable on the running event loop.
+struct Writable {
+  /// The file descriptor to wait on.
+  int file;
+  
+  bool await_ready() const noexcept { return false; }
+  
+  void await_suspend(std::coroutine_handle<> handle) const {
+    EventLoop::current()->waitWritable(file, [=]() -> void {
+      handle.resume();
+    });
+  }
+  
+  void await_resume() const noexcept { }
+};
+
+/// Waits for an amount of time to pass on the running event loop.
+struct Sleep {
+  /// The time to wait, in nanoseconds.
+  long long nanoseconds;
+  
+  bool await_ready() const noexcept { return false; }
+  
+  void await_suspend(std::coroutine_handle<> handle) const {
+    EventLoop::current()->waitFor(nanoseconds, [=]() -> void {
+      handle.resume();
+    });
+  }
+  
+  void await_resume() const noexcept { }
+};
+
+/// Wait for a file to become readable, or to be closed or have an error.
+/// \param[in] file
+///   The file descriptor to wait on.
+inline Readable readable(int file) {
+  return Readable { file };
+}
+
+/// Wait for a file to become writable, or to be closed or have an error.
+/// \param[in] file
+///   The file descriptor to wait on.
+inline Writable writable(int file) {
+  return Writable { file };
+}
+
+/// Wait for an amount of time to pass.
+/// \param[in] duration
+///   The time to wait.
+template<typename Rep, typename Period>
+Sleep sleepFor(std::chrono::duration<Rep, Period> duration) {
+  return Sleep {
+    (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      duration).count()
+  };
+}
+
+
+
+END_NAMESPACE_EXPECT
+
+
+
+/// Define an asynchronous unit test case, whose body is a coroutine.
+/// \param name
+///   The name of the test case.
+/// \param description
+///   A description of the unit test used when displaying help.
+/// \param ...
+///   Optional.
+///   A list of all of the tags associated with the test case.
+/// \remarks
+///   Needs C++20.
+///   The body of the test case can `co_await` `readable(file)`,
+///   `writable(file)` and `sleepFor(duration)`, letting other asynchronous
+///   test cases run on the same thread while it waits.
+///   Example:
+///   ```
+///   ASYNC_TEST(my test, "Test reading from a pipe.") {
+///     co_await readable(pipe);
+///     EXPECT read(pipe, buffer, 4) == 4;
+///   };
+///   ```
+/// \sa TEST(name, description, ...)
+#define ASYNC_TEST(name, description, ...) \
+  _EXPECT_ASYNC_TEST(_EXPECT_UNIQUE(__expectTest), name, description, \
+    __VA_ARGS__)
+
+#define _EXPECT_ASYNC_TEST(storage, name, description, ...) \
+  static NAMESPACE_EXPECT TestStorage storage; \
+  NAMESPACE_EXPECT AddAsync { NAMESPACE_EXPECT Test::Add(&storage, tests, \
+    #name, description, { _EXPECT_STRINGIFY_ARGS(__VA_ARGS__) }, __FILE__, \
+    __LINE__).test }, \
+    [=](NAMESPACE_EXPECT Environment &__environment) -> \
+      NAMESPACE_EXPECT AsyncTest
+
+#endif
@@ -12,13 +12,25 @@
 #include <Expect Common.h>
 #include <Global/Environment.h>
 #include <Global/Iterate.h>
+#include <Global/LinkedList.h>
 #include <vector>
+#include <exception>
 #include <functional>
+#include <type_traits>
 
 START_NAMESPACE_EXPECT
 
 
 
+/// Starts an asynchronous unit test case on the event loop running on the
+/// calling thread.
+/// \remarks
+///   Takes the test environment to run the test case in and a callback for
+///   when the test case finishes, with the exception that stopped it, if any.
+///   Returns a function that abandons the test case if it hasn't finished.
+typedef std::function<std::function<void()>(
+  Environment &, std::function<void(std::exception_ptr)>)> AsyncDriver;
+
 /// A unit test case.
 struct Test {
   /// A helper struct to add unit tests using the `TEST(...)` macro
@@ -27,6 +39,9 @@ struct Test {
     Test *test;
     
     /// Create a new unit test case.
+    /// \param[out] storage
+    ///   The `TestStorage` to create the unit test case in.
+    ///   Must outlive the list of tests.
     /// \param[inout] tests
     ///   The list of tests in which this test case should be recorded.
     /// \param[in] name
@@ -35,11 +50,18 @@ struct Test {
     ///   A description of the unit test.
     /// \param[in] tags
     ///   A set of tags associated with the unit test.
+    /// \param[in] file
+    ///   The source file that the unit test is defined in.
+    /// \param[in] line
+    ///   The line that the unit test is defined on.
     Add(
-      std::vector<Test> *tests      ,
-      const char        *name       ,
-      const char        *description,
-      std::vector<const char *> tags
+      void             *storage    ,
+      LinkedList<Test> &tests      ,
+      const char       *name       ,
+      const char       *description,
+      std::vector<const char *> tags,
+      const char       *file = nullptr,
+      int               line = 0
     );
     
     /// Add a test driver to the unit test case.
@@ -59,13 +81,42 @@ struct Test {
   /// The test driver.
   std::function<void(Environment &)> test;
   
+  /// The asynchronous test driver, or `nullptr` if the unit test isn't
+  /// asynchronous.
+  /// \sa ASYNC_TEST(name, description, ...)
+  AsyncDriver async;
+  
   /// Whether or not the unit test should be ran.
   bool enabled;
   
   /// The test tags.
   std::vector<const char *> tags;
+  
+  /// The source file that the unit test is defined in, or `nullptr` if it is
+  /// unknown.
+  const char *file;
+  
+  /// The line that the unit test is defined on, or `0` if it is unknown.
+  int line;
+  
+  /// The next unit test in the test suite.
+  Test *next;
+  
+  /// Get the time limit of the unit test.
+  /// \param[in] fallback
+  ///   The time limit to use if the unit test has no `timeout(ms)` tag, in
+  ///   milliseconds.
+  /// \returns
+  ///   The time limit of the unit test in milliseconds, or `0` for no limit.
+  long long timeLimit(long long fallback) const;
 };
 
+/// Statically allocated storage for a unit test case.
+/// \remarks
+///   Never destroyed, so that registering a unit test case doesn't register a
+///   destructor to run at exit.
+typedef std::aligned_storage<sizeof(Test), alignof(Test)>::type TestStorage;
+
 
 
 END_NAMESPACE_EXPECT
@@ -82,7 +133,8 @@ END_NAMESPACE_EXPECT
 ///   A list of all of the tags associated with the test case.
 ///   Specially handled tags are `benchmark`, and `skip` which prevent the test
 ///   case from being run in aggregate tests, such as when an entire test suite
-///   is specified to be tested.
+///   is specified to be tested, and `timeout(ms)` which limits how long the
+///   test case may run for.
 /// \remarks
 ///   The body of the test case should be terminated by a semicolon.
 ///   Example:
@@ -94,6 +146,10 @@ END_NAMESPACE_EXPECT
 ///   All test cases should be enclosed in a test suite.
 /// \sa SUITE(name)
 #define TEST(name, description, ...) \
-  NAMESPACE_EXPECT Test::Add(&tests, #name, description, \
-    { _EXPECT_STRINGIFY_ARGS(__VA_ARGS__) }), \
+  _EXPECT_TEST(_EXPECT_UNIQUE(__expectTest), name, description, __VA_ARGS__)
+
+#define _EXPECT_TEST(storage, name, description, ...) \
+  static NAMESPACE_EXPECT TestStorage storage; \
+  NAMESPACE_EXPECT Test::Add(&storage, tests, #name, description, \
+    { _EXPECT_STRINGIFY_ARGS(__VA_ARGS__) }, __FILE__, __LINE__), \
     [=](NAMESPACE_EXPECT Environment &__environment) -> void
@@ -0,0 +1,201 @@
+// ===--- Allocations.cpp ---------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of counting heap allocations in benchmarks.                 //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Benchmarking/Allocations.h>
+#include <stdlib.h>
+#if EXPECT_ALLOCATION_TRACKING
+#include <new>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#include <errno.h>
+#define _EXPECT_REPLACE_MALLOC 1
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#define _EXPECT_BLOCK_SIZE(block) malloc_size(block)
+#elif defined(_WIN32)
+#include <malloc.h>
+#define _EXPECT_BLOCK_SIZE(block) _msize(block)
+#else
+#include <malloc.h>
+#define _EXPECT_BLOCK_SIZE(block) malloc_usable_size(block)
+#endif
+#endif
+
+/// The heap allocations made by the calling thread.
+/// \remarks
+///   Kept in the static thread local storage of the executable where
+///   possible, since allocating the thread local storage of a shared library
+///   can itself call `malloc`.
+#if defined(__GNUC__)
+__attribute__((tls_model("initial-exec")))
+#endif
+static thread_local NAMESPACE_EXPECT AllocationCounters threadAllocations = { };
+
+NAMESPACE_EXPECT AllocationCounters &NAMESPACE_EXPECT allocationCounters() {
+  return threadAllocations;
+}
+
+
+
+#if EXPECT_ALLOCATION_TRACKING
+/// Count an allocation.
+/// \param[in] bytes
+///   The number of bytes requested.
+/// \param[in] size
+///   The size of the block that was allocated.
+static inline void countAllocation(
+  size_t bytes,
+  size_t size
+) {
+  threadAllocations.allocations++;
+  threadAllocations.bytes += bytes;
+  threadAllocations.live += (long long)size;
+  if (threadAllocations.live > threadAllocations.peak)
+    threadAllocations.peak = threadAllocations.live;
+}
+
+/// Count the freeing of an allocation.
+/// \param[in] size
+///   The size of the block that was freed.
+static inline void countFree(size_t size) {
+  threadAllocations.live -= (long long)size;
+}
+
+#if _EXPECT_REPLACE_MALLOC
+// The C library allocator stays available under its own names, so every
+// allocation, including those made by `operator new`, is counted here
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *block, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void *__libc_valloc(size_t size);
+void *__libc_pvalloc(size_t size);
+void __libc_free(void *block);
+
+void *malloc(size_t size) noexcept {
+  void *block = __libc_malloc(size);
+  if (block != nullptr)
+    countAllocation(size, malloc_usable_size(block));
+  return block;
+}
+
+void *calloc(size_t count, size_t size) noexcept {
+  void *block = __libc_calloc(count, size);
+  if (block != nullptr)
+    countAllocation(count * size, malloc_usable_size(block));
+  return block;
+}
+
+void *realloc(void *block, size_t size) noexcept {
+  size_t previous = block != nullptr ? malloc_usable_size(block) : 0;
+  void *reallocated = __libc_realloc(block, size);
+  if (reallocated != nullptr || size == 0)
+    countFree(previous);
+  if (reallocated != nullptr)
+    countAllocation(size, malloc_usable_size(reallocated));
+  return reallocated;
+}
+
+void *reallocarray(void *block, size_t count, size_t size) noexcept {
+  if (size != 0 && count > (size_t)-1 / size) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  return realloc(block, count * size);
+}
+
+void *memalign(size_t alignment, size_t size) noexcept {
+  void *block = __libc_memalign(alignment, size);
+  if (block != nullptr)
+    countAllocation(size, malloc_usable_size(block));
+  return block;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) noexcept {
+  return memalign(alignment, size);
+}
+
+int posix_memalign(void **block, size_t alignment, size_t size) noexcept {
+  if (alignment % sizeof(void *) != 0 ||
+      (alignment & (alignment - 1)) != 0)
+    return EINVAL;
+  void *allocated = memalign(alignment, size);
+  if (allocated == nullptr)
+    return ENOMEM;
+  *block = allocated;
+  return 0;
+}
+
+void *valloc(size_t size) noexcept {
+  void *block = __libc_valloc(size);
+  if (block != nullptr)
+    countAllocation(size, malloc_usable_size(block));
+  return block;
+}
+
+void *pvalloc(size_t size) noexcept {
+  void *block = __libc_pvalloc(size);
+  if (block != nullptr)
+    countAllocation(size, malloc_usable_size(block));
+  return block;
+}
+
+void free(void *block) noexcept {
+  if (block != nullptr)
+    countFree(malloc_usable_size(block));
+  __libc_free(block);
+}
+}
+#else
+// Without a way to replace `malloc`, only allocations made by `operator new`
+// are counted
+void *operator new(size_t size) {
+  void *block = malloc(size == 0 ? 1 : size);
+  if (block == nullptr)
+    throw std::bad_alloc();
+  countAllocation(size, _EXPECT_BLOCK_SIZE(block));
+  return block;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  void *block = malloc(size == 0 ? 1 : size);
+  if (block != nullptr)
+    countAllocation(size, _EXPECT_BLOCK_SIZE(block));
+  return block;
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void *block) noexcept {
+  if (block != nullptr)
+    countFree(_EXPECT_BLOCK_SIZE(block));
+  free(block);
+}
+
+void operator delete[](void *block) noexcept {
+  operator delete(block);
+}
+
+void operator delete(void *block, const std::nothrow_t &) noexcept {
+  operator delete(block);
+}
+
+void operator delete[](void *block, const std::nothrow_t &) noexcept {
+  operator delete(block);
+}
+#endif
+#endif
@@ -9,45 +9,210 @@
 // ===--------------------------------------------------------------------=== //
 
 #include <Benchmarking/Benchmark.h>
+#include <math.h>
+
+/// The most times that the benchmarked code may run in a single iteration.
+#define _EXPECT_MAX_BENCHMARK_BATCH ((size_t)1 << 30)
+
+/// Get the relative half width of the 95% confidence interval of the median of
+/// some times.
+/// \remarks
+///   The interval lies between the order statistics about `0.98 sqrt(n)` either
+///   side of the median, which holds whatever the distribution of the times.
+static double medianPrecision(std::vector<double> times) {
+  size_t count = times.size();
+  double spread = 0.98 * sqrt((double)count);
+  long long lower = (long long)floor(count / 2.0 - spread) - 1;
+  long long upper = (long long)ceil(count / 2.0 + 1 + spread) - 1;
+  size_t low = lower < 0 ? 0 : (size_t)lower;
+  size_t high = upper >= (long long)count ? count - 1 : (size_t)upper;
+  
+  std::nth_element(times.begin(), times.begin() + count / 2, times.end());
+  double median = times[count / 2];
+  std::nth_element(
+    times.begin(), times.begin() + low, times.begin() + count / 2);
+  std::nth_element(
+    times.begin() + count / 2, times.begin() + high, times.end());
+  double width = times[high] - times[low];
+  if (median <= 0)
+    return width > 0 ? HUGE_VAL : 0;
+  return width / (2 * median);
+}
+
+/// Get the time between two clock readings, in nanoseconds.
+static long long elapsed(
+  std::chrono::steady_clock::time_point start,
+  std::chrono::steady_clock::time_point end
+) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    end - start).count();
+}
+
+long long NAMESPACE_EXPECT timerOverhead() {
+  static const long long overhead = []() -> long long {
+    std::vector<long long> times(1001);
+    for (long long &time : times) {
+      auto start = std::chrono::steady_clock::now();
+      time = elapsed(start, std::chrono::steady_clock::now());
+    }
+    std::nth_element(times.begin(), times.begin() + 500, times.end());
+    return times[500];
+  }();
+  return overhead;
+}
+
+long long NAMESPACE_EXPECT timerResolution() {
+  static const long long resolution = []() -> long long {
+    long long smallest = 0;
+    for (int i = 0; i < 100; i++) {
+      auto start = std::chrono::steady_clock::now(), end = start;
+      while (end == start)
+        end = std::chrono::steady_clock::now();
+      long long step = elapsed(start, end);
+      if (smallest == 0 || step < smallest)
+        smallest = step;
+    }
+    return smallest;
+  }();
+  return resolution;
+}
+
+/// Measure how much each hardware performance counter counts around an empty
+/// benchmark iteration.
+/// \param[inout] counters
+///   The started hardware performance counters.
+/// \param[out] overhead
+///   The median count of each counter around an empty iteration, left alone
+///   if the counters couldn't be read.
+static void measureCounterOverhead(
+  NAMESPACE_EXPECT PerformanceCounters &counters,
+  uint64_t overhead[(size_t)NAMESPACE_EXPECT Counter::Count]
+) {
+  const size_t count = (size_t)NAMESPACE_EXPECT Counter::Count;
+  std::vector<uint64_t> deltas[count];
+  for (int i = 0; i < 101; i++) {
+    // Mirror an iteration: read the counters, read the clock twice, then read
+    // the counters again
+    uint64_t before[count], after[count];
+    if (!counters.read(before))
+      return;
+    auto start = std::chrono::steady_clock::now();
+    long long time = elapsed(start, std::chrono::steady_clock::now());
+    (void)time;
+    if (!counters.read(after))
+      return;
+    for (size_t j = 0; j < count; j++)
+      if (counters.files[j] >= 0)
+        deltas[j].push_back(after[j] - before[j]);
+  }
+  for (size_t j = 0; j < count; j++)
+    if (!deltas[j].empty()) {
+      std::nth_element(
+        deltas[j].begin(), deltas[j].begin() + 50, deltas[j].end());
+      overhead[j] = deltas[j][50];
+    }
+}
 
 NAMESPACE_EXPECT Benchmark::Benchmark(
   Environment &environment,
   const int    line
 ) : environment(environment), line(line) { }
 
-bool NAMESPACE_EXPECT Benchmark::operator()() {
+bool NAMESPACE_EXPECT Benchmark::next() {
   if (iterations == 0 && !environment.success)
     // Preconditions failed: do not benchmark
     return false;
   
-  if (iterations < 16 || totalTime <= 1000000000 && iterations < 1024) {
+  // Run the minimum, then stop at the maximum or once the median is precise
+  // enough, checking the precision each time the iterations grow by a tenth
+  // so that checking takes linear time overall
+  const BenchmarkSettings &settings = environment.benchmarking;
+  bool done;
+  if (iterations == 0 || iterations < settings.minIterations ||
+      totalTime < settings.minTime)
+    done = false;
+  else if (iterations >= settings.maxIterations ||
+           totalTime > settings.maxTime)
+    done = true;
+  else if (settings.precision <= 0 || iterations < nextCheck)
+    done = false;
+  else {
+    nextCheck = iterations + iterations / 10 + 1;
+    done = medianPrecision(times) <= settings.precision;
+  }
+  
+  if (!done) {
     // Continue iterating
+    if (iterations == 0 && calibrating && batch == 1 && settings.counters) {
+      counting = counters.start();
+      if (counting)
+        measureCounterOverhead(counters, counterOverhead);
+    }
+    if (counting)
+      counting = counters.read(counted);
+    #if EXPECT_ALLOCATION_TRACKING
+    AllocationCounters &allocations = allocationCounters();
+    allocations.peak = allocations.live;
+    allocated = allocations;
+    #endif
     start = std::chrono::steady_clock::now();
     return true;
   } else {
     // Sufficient iterations reached
     
     // Record how long each iteration took
-    std::vector<long long> iterationTimes = times;
+    std::vector<double> iterationTimes = times;
     
     // Sort times for computation
     std::sort(times.begin(), times.end());
     
     // Compute results
+    double sum = 0;
+    for (double time : times)
+      sum += time;
     size_t half = times.size() / 2;
     size_t quarter = times.size() / 4;
+    double averages[(size_t)Counter::Count];
+    for (size_t i = 0; i < (size_t)Counter::Count; i++)
+      averages[i] = counting && counters.files[i] >= 0 ?
+        counterTotals[i] / ((double)iterations * batch) : -1;
+    #if EXPECT_ALLOCATION_TRACKING
+    double runs = (double)iterations * batch;
+    double allocations = allocationTotals.allocations / runs;
+    double allocatedBytes = allocationTotals.bytes / runs;
+    long long peakBytes = allocationTotals.peak;
+    #else
+    double allocations = -1, allocatedBytes = -1;
+    long long peakBytes = -1;
+    #endif
+    double cycles = averages[(size_t)Counter::Cycles];
+    double instructions = averages[(size_t)Counter::Instructions];
     BenchmarkResult result {
       line,
       iterations,
       totalTime,
-      totalTime / (long long)iterations, // meanTime
+      sum / (double)iterations, // meanTime
       times[half], // medianTime
       times[0], // minTime
       times[times.size() - 1], // maxTime
       times[quarter], // q1Time
       times[times.size() - 1 - quarter], // q3Time
-      iterationTimes
+      iterationTimes,
+      medianPrecision(times),
+      batch,
+      cycles,
+      instructions,
+      averages[(size_t)Counter::BranchMisses],
+      averages[(size_t)Counter::L1dMisses],
+      averages[(size_t)Counter::LLCMisses],
+      averages[(size_t)Counter::DTLBMisses],
+      cycles > 0 && instructions >= 0 ? instructions / cycles : -1, // ipc
+      allocations,
+      allocatedBytes,
+      peakBytes,
+      environment.benchmarkParameters
     };
+    counters.stop();
     
     // Record results
     environment.benchmarks.push_back(result);
@@ -57,13 +222,45 @@ bool NAMESPACE_EXPECT Benchmark::operator()() {
   }
 }
 
-void NAMESPACE_EXPECT Benchmark::operator++(int) {
+void NAMESPACE_EXPECT Benchmark::finish() {
   // Record the time that the iteration took
-  auto end = std::chrono::steady_clock::now();
-  auto elapsed =
-    std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
-  long long time = elapsed.count();
-  times.push_back(time);
+  long long time = elapsed(start, std::chrono::steady_clock::now());
+  repeat = 0;
+  #if EXPECT_ALLOCATION_TRACKING
+  AllocationCounters allocations = allocationCounters();
+  #endif
+  uint64_t values[(size_t)Counter::Count];
+  if (counting)
+    counting = counters.read(values);
+  
+  // Run the benchmarked code twice as many times in each iteration until an
+  // iteration takes long enough for reading the clock not to matter
+  if (calibrating) {
+    long long target =
+      1000 * std::max(std::max(timerOverhead(), timerResolution()), 1ll);
+    if (time < target && batch < _EXPECT_MAX_BENCHMARK_BATCH) {
+      batch *= 2;
+      return;
+    }
+    calibrating = false;
+  }
+  
+  // Take out what reading the clock and the counters counted, as for time
+  if (counting)
+    for (size_t i = 0; i < (size_t)Counter::Count; i++)
+      if (counters.files[i] >= 0) {
+        uint64_t count = values[i] - counted[i];
+        counterTotals[i] +=
+          count > counterOverhead[i] ? count - counterOverhead[i] : 0;
+      }
+  #if EXPECT_ALLOCATION_TRACKING
+  allocationTotals.allocations +=
+    allocations.allocations - allocated.allocations;
+  allocationTotals.bytes += allocations.bytes - allocated.bytes;
+  allocationTotals.peak =
+    std::max(allocationTotals.peak, allocations.peak - allocated.live);
+  #endif
+  times.push_back(std::max(time - timerOverhead(), 0ll) / (double)batch);
   totalTime += time;
   iterations++;
 }
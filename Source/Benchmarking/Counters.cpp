@@ -0,0 +1,148 @@
+// ===--- Counters.cpp ------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of reading hardware performance counters in benchmarks.     //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Benchmarking/Counters.h>
+#include <initializer_list>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <string.h>
+#define _EXPECT_PERF 1
+#endif
+
+#if _EXPECT_PERF
+/// Open a performance counter of the calling thread.
+/// \param[in] type
+///   The type of the counter.
+/// \param[in] config
+///   The counter within its type.
+/// \param[in] group
+///   The file of the counter leading the group, or `-1` to lead a new group.
+/// \returns
+///   The file of the counter, or `-1` if it couldn't be opened.
+static int openCounter(
+  uint32_t type  ,
+  uint64_t config,
+  int      group
+) {
+  perf_event_attr attributes;
+  memset(&attributes, 0, sizeof(attributes));
+  attributes.size = sizeof(attributes);
+  attributes.type = type;
+  attributes.config = config;
+  attributes.disabled = group < 0;
+  attributes.exclude_kernel = 1;
+  attributes.exclude_hv = 1;
+  attributes.read_format = PERF_FORMAT_GROUP |
+    PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return (int)syscall(
+    SYS_perf_event_open, &attributes, 0, -1, group, PERF_FLAG_FD_CLOEXEC);
+}
+
+/// Get the configuration of a cache read miss counter.
+#define _EXPECT_CACHE_MISS(cache) \
+  ((cache) | PERF_COUNT_HW_CACHE_OP_READ << 8 | \
+    PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+#endif
+
+NAMESPACE_EXPECT PerformanceCounters::PerformanceCounters() {
+  for (size_t i = 0; i < (size_t)Counter::Count; i++) {
+    files[i] = -1;
+    positions[i] = 0;
+  }
+}
+
+NAMESPACE_EXPECT PerformanceCounters::~PerformanceCounters() {
+  stop();
+}
+
+bool NAMESPACE_EXPECT PerformanceCounters::start() {
+  stop();
+  #if _EXPECT_PERF
+  static const struct {
+    uint32_t type;
+    uint64_t config;
+  } counters[(size_t)Counter::Count] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_HW_CACHE, _EXPECT_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D) },
+    { PERF_TYPE_HW_CACHE, _EXPECT_CACHE_MISS(PERF_COUNT_HW_CACHE_LL) },
+    { PERF_TYPE_HW_CACHE, _EXPECT_CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+  };
+  
+  // Leave out the counters that can't be opened, rather than giving up on all
+  // of them, and fall back to cycles and instructions, which most CPUs count
+  // on counters of their own, if the whole group doesn't fit on the CPU at
+  // once, since a group that doesn't is never counted
+  for (size_t wanted : { (size_t)Counter::Count, (size_t)2 }) {
+    int group = -1;
+    for (size_t i = 0; i < wanted; i++) {
+      files[i] = openCounter(counters[i].type, counters[i].config, group);
+      if (files[i] < 0)
+        continue;
+      if (group < 0)
+        group = files[i];
+      positions[i] = open++;
+    }
+    if (group < 0)
+      return false;
+    
+    uint64_t values[(size_t)Counter::Count];
+    ioctl(group, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    if (read(values))
+      return true;
+    stop();
+  }
+  return false;
+  #else
+  return false;
+  #endif
+}
+
+void NAMESPACE_EXPECT PerformanceCounters::stop() {
+  #if _EXPECT_PERF
+  // Close the group leader last
+  for (size_t i = (size_t)Counter::Count; i-- > 0; )
+    if (files[i] >= 0)
+      close(files[i]);
+  #endif
+  for (size_t i = 0; i < (size_t)Counter::Count; i++)
+    files[i] = -1;
+  open = 0;
+}
+
+bool NAMESPACE_EXPECT PerformanceCounters::read(
+  uint64_t values[(size_t)Counter::Count]
+) {
+  #if _EXPECT_PERF
+  if (open == 0)
+    return false;
+  int group = -1;
+  for (size_t i = 0; i < (size_t)Counter::Count && group < 0; i++)
+    group = files[i];
+  
+  // `count, time enabled, time running, values...`
+  uint64_t data[3 + (size_t)Counter::Count];
+  ssize_t size = ::read(group, data, sizeof(data));
+  if (size < (ssize_t)((3 + open) * sizeof(uint64_t)) || data[0] != open ||
+      data[2] == 0)
+    return false;
+  for (size_t i = 0; i < (size_t)Counter::Count; i++)
+    if (files[i] >= 0)
+      values[i] = data[3 + positions[i]];
+  return true;
+  #else
+  (void)values;
+  return false;
+  #endif
+}
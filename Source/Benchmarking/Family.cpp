@@ -0,0 +1,192 @@
+// ===--- Family.cpp --------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of benchmark families and fitting their complexity.         //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Benchmarking/Family.h>
+#include <math.h>
+
+/// Get the growth of a complexity class at a value of its parameter.
+static double growth(
+  NAMESPACE_EXPECT Complexity complexity,
+  long long                   value
+) {
+  double n = value > 0 ? (double)value : 0;
+  double logarithm = n > 1 ? log2(n) : 0;
+  switch (complexity) {
+  case NAMESPACE_EXPECT Complexity::Constant:
+    return 1;
+  case NAMESPACE_EXPECT Complexity::Logarithmic:
+    return logarithm;
+  case NAMESPACE_EXPECT Complexity::Linear:
+    return n;
+  case NAMESPACE_EXPECT Complexity::Linearithmic:
+    return n * logarithm;
+  case NAMESPACE_EXPECT Complexity::Quadratic:
+    return n * n;
+  }
+  return 0;
+}
+
+/// Check whether two benchmark results were run in the same sweep of a
+/// benchmark family.
+static bool sameSweep(
+  const NAMESPACE_EXPECT BenchmarkResult &lhs,
+  const NAMESPACE_EXPECT BenchmarkResult &rhs
+) {
+  if (lhs.line != rhs.line || lhs.parameters.size() != rhs.parameters.size())
+    return false;
+  for (size_t i = 0; i + 1 < lhs.parameters.size(); i++)
+    if (lhs.parameters[i].name != rhs.parameters[i].name ||
+        lhs.parameters[i].value != rhs.parameters[i].value)
+      return false;
+  return lhs.parameters.back().name == rhs.parameters.back().name;
+}
+
+NAMESPACE_EXPECT BenchmarkFamily::BenchmarkFamily(
+  Environment            &environment,
+  const char             *name,
+  std::vector<long long>  values
+) : environment(environment), name(name), values(std::move(values)) { }
+
+NAMESPACE_EXPECT BenchmarkFamily::~BenchmarkFamily() {
+  if (pushed)
+    environment.benchmarkParameters.pop_back();
+}
+
+bool NAMESPACE_EXPECT BenchmarkFamily::operator()() {
+  if (index >= values.size() || !environment.success)
+    return false;
+  environment.benchmarkParameters.push_back({ name, values[index] });
+  pushed = true;
+  return true;
+}
+
+void NAMESPACE_EXPECT BenchmarkFamily::operator++(int) {
+  if (pushed)
+    environment.benchmarkParameters.pop_back();
+  pushed = false;
+  index++;
+}
+
+std::vector<long long> NAMESPACE_EXPECT parameterRange(
+  long long first,
+  long long last,
+  long long step
+) {
+  std::vector<long long> values = { };
+  if (step <= 0)
+    return values;
+  for (long long value = first; value <= last; value += step) {
+    values.push_back(value);
+    if (last - value < step)
+      break;
+  }
+  return values;
+}
+
+std::vector<long long> NAMESPACE_EXPECT parameterPowers(
+  long long first,
+  long long last
+) {
+  std::vector<long long> values = { };
+  long long value = 1;
+  while (value < first && value <= last / 2)
+    value *= 2;
+  for (; value >= first && value <= last; value *= 2) {
+    values.push_back(value);
+    if (value > last / 2)
+      break;
+  }
+  return values;
+}
+
+std::vector<NAMESPACE_EXPECT ComplexityFit> NAMESPACE_EXPECT fitComplexity(
+  const std::vector<BenchmarkResult> &benchmarks
+) {
+  std::vector<ComplexityFit> fits = { };
+  std::vector<bool> fitted(benchmarks.size(), false);
+  for (size_t i = 0; i < benchmarks.size(); i++) {
+    if (fitted[i] || benchmarks[i].parameters.empty())
+      continue;
+    
+    // Gather the points of the sweep
+    std::vector<const BenchmarkResult *> points = { };
+    for (size_t j = i; j < benchmarks.size(); j++)
+      if (sameSweep(benchmarks[i], benchmarks[j])) {
+        points.push_back(&benchmarks[j]);
+        fitted[j] = true;
+      }
+    bool distinct = false;
+    for (const BenchmarkResult *point : points)
+      if (point->parameters.back().value !=
+          points[0]->parameters.back().value)
+        distinct = true;
+    if (!distinct)
+      continue;
+    
+    // Fit `time = coefficient * growth(n)` by least squares for each class
+    double mean = 0;
+    for (const BenchmarkResult *point : points)
+      mean += point->medianTime;
+    mean /= (double)points.size();
+    ComplexityFit fit {
+      benchmarks[i].line,
+      std::vector<BenchmarkParameter>(
+        benchmarks[i].parameters.begin(), benchmarks[i].parameters.end() - 1),
+      benchmarks[i].parameters.back().name,
+      points.size(),
+      Complexity::Constant,
+      0,
+      HUGE_VAL
+    };
+    for (Complexity complexity : {
+        Complexity::Constant, Complexity::Logarithmic, Complexity::Linear,
+        Complexity::Linearithmic, Complexity::Quadratic }) {
+      double products = 0, squares = 0;
+      for (const BenchmarkResult *point : points) {
+        double g = growth(complexity, point->parameters.back().value);
+        products += point->medianTime * g;
+        squares += g * g;
+      }
+      if (squares <= 0)
+        continue;
+      double coefficient = products / squares, error = 0;
+      for (const BenchmarkResult *point : points) {
+        double residual = point->medianTime -
+          coefficient * growth(complexity, point->parameters.back().value);
+        error += residual * residual;
+      }
+      error = sqrt(error / (double)points.size());
+      double rms = mean > 0 ? error / mean : error;
+      if (rms < fit.rms) {
+        fit.complexity = complexity;
+        fit.coefficient = coefficient;
+        fit.rms = rms;
+      }
+    }
+    fits.push_back(fit);
+  }
+  return fits;
+}
+
+const char *NAMESPACE_EXPECT complexityName(Complexity complexity) {
+  switch (complexity) {
+  case Complexity::Constant:
+    return "O(1)";
+  case Complexity::Logarithmic:
+    return "O(log n)";
+  case Complexity::Linear:
+    return "O(n)";
+  case Complexity::Linearithmic:
+    return "O(n log n)";
+  case Complexity::Quadratic:
+    return "O(n^2)";
+  }
+  return "O(?)";
+}
@@ -0,0 +1,242 @@
+// ===--- Cache.cpp ---------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of skipping test cases that passed in an identical build.   //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Driver/Cache.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <algorithm>
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+#if defined(__linux__) && defined(__GLIBC__)
+#include <link.h>
+#define _EXPECT_BUILD_ID 1
+#endif
+
+/// Get the key of a test case in a result cache.
+static std::string cacheKey(
+  NAMESPACE_EXPECT Suite &suite,
+  NAMESPACE_EXPECT Test  &test
+) {
+  return std::string(suite.name).append("\t").append(test.name);
+}
+
+/// Get whether or not a test case may be skipped when it passed before.
+static bool cacheable(NAMESPACE_EXPECT Test &test) {
+  for (const char *tag : test.tags)
+    if (strcmp(tag, "benchmark") == 0 || strcmp(tag, "nocache") == 0)
+      return false;
+  return true;
+}
+
+/// Mix bytes into a 64-bit FNV-1a hash.
+static void hashBytes(uint64_t &hash, const void *data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    hash ^= ((const unsigned char *)data)[i];
+    hash *= 1099511628211ull;
+  }
+}
+
+/// Write bytes out as hexadecimal.
+static void appendHex(std::string &string, const void *data, size_t length) {
+  static const char digits[] = "0123456789abcdef";
+  for (size_t i = 0; i < length; i++) {
+    unsigned char byte = ((const unsigned char *)data)[i];
+    string.push_back(digits[byte >> 4]);
+    string.push_back(digits[byte & 0xf]);
+  }
+}
+
+/// Get a hash of the contents of a file.
+/// \returns
+///   The hexadecimal hash, or an empty string if the file couldn't be read.
+static std::string hashFile(const char *path) {
+  std::string identifier = "";
+  FILE *handle = fopen(path, "rb");
+  if (handle == NULL)
+    return identifier;
+  uint64_t hash = 14695981039346656037ull;
+  char buffer[65536];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), handle)) > 0)
+    hashBytes(hash, buffer, read);
+  fclose(handle);
+  appendHex(identifier, &hash, sizeof(hash));
+  return identifier;
+}
+
+#if _EXPECT_BUILD_ID
+
+/// Find the GNU build-id note of each loaded object, the main executable
+/// first, falling back on a hash of the shared objects that have none.
+static int findBuildIds(struct dl_phdr_info *info, size_t, void *data) {
+  std::vector<std::string> &identifiers = *(std::vector<std::string> *)data;
+  std::string identifier = "";
+  for (ElfW(Half) i = 0; i < info->dlpi_phnum && identifier.empty(); i++) {
+    const ElfW(Phdr) &header = info->dlpi_phdr[i];
+    if (header.p_type != PT_NOTE)
+      continue;
+    
+    // Notes are a header, a name and a description, each 4-byte aligned
+    const char *note = (const char *)(info->dlpi_addr + header.p_vaddr);
+    const char *end = note + header.p_memsz;
+    while (note + sizeof(ElfW(Nhdr)) <= end) {
+      const ElfW(Nhdr) &entry = *(const ElfW(Nhdr) *)note;
+      const char *name = note + sizeof(ElfW(Nhdr));
+      const char *description = name + ((entry.n_namesz + 3) & ~3u);
+      if (entry.n_type == NT_GNU_BUILD_ID && entry.n_namesz == 4 &&
+          memcmp(name, "GNU", 4) == 0) {
+        appendHex(identifier, description, entry.n_descsz);
+        break;
+      }
+      note = description + ((entry.n_descsz + 3) & ~3u);
+    }
+  }
+  
+  // The main executable is always listed first, without a name
+  if (identifier.empty() && !identifiers.empty() &&
+      info->dlpi_name != nullptr && info->dlpi_name[0] != '\0')
+    identifier = hashFile(info->dlpi_name);
+  identifiers.push_back(identifier);
+  return 0;
+}
+
+#endif
+
+std::string NAMESPACE_EXPECT buildIdentifier(
+  const char                     *executable,
+  const std::vector<std::string> &plugins
+) {
+  // Identify the executable, then every other object that its test cases may
+  // have come from
+  std::vector<std::string> objects = { };
+  #if _EXPECT_BUILD_ID
+  (void)plugins;
+  dl_iterate_phdr(findBuildIds, &objects);
+  #else
+  objects.push_back("");
+  for (const std::string &plugin : plugins)
+    objects.push_back(hashFile(plugin.c_str()));
+  #endif
+  if (objects.empty() || objects[0].empty()) {
+    // Fall back on a hash of the executable itself
+    if (objects.empty())
+      objects.push_back("");
+    objects[0] = hashFile(executable);
+    if (objects[0].empty())
+      return objects[0];
+  }
+  if (objects.size() == 1)
+    return objects[0];
+  
+  // Load order may change with the tests selected, so sort the rest
+  std::sort(objects.begin() + 1, objects.end());
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 1; i < objects.size(); i++)
+    hashBytes(hash, objects[i].c_str(), objects[i].size() + 1);
+  std::string identifier = objects[0];
+  identifier.push_back('-');
+  appendHex(identifier, &hash, sizeof(hash));
+  return identifier;
+}
+
+
+
+bool NAMESPACE_EXPECT ResultCache::open(
+  const char                     *directory  ,
+  const char                     *executable ,
+  const std::vector<std::string> &plugins    ,
+  const Environment              &environment
+) {
+  passed.clear();
+  path.clear();
+  
+  std::string identifier = buildIdentifier(executable, plugins);
+  if (identifier.empty())
+    return false;
+  
+  #if defined(_WIN32)
+  if (_mkdir(directory) != 0 && errno != EEXIST)
+  #else
+  if (mkdir(directory, 0777) != 0 && errno != EEXIST)
+  #endif
+    return false;
+  
+  // Test cases may pass or fail differently under other flags
+  uint64_t flags = 14695981039346656037ull;
+  hashBytes(flags, &environment.stopOnFailure, sizeof(bool));
+  hashBytes(flags, &environment.timeout, sizeof(long long));
+  path = std::string(directory).append("/").append(identifier).append("-");
+  appendHex(path, &flags, sizeof(flags));
+  path.append(".passed");
+  
+  FILE *handle = fopen(path.c_str(), "r");
+  if (handle == NULL)
+    return true;
+  
+  std::string line = "";
+  for (int c = fgetc(handle); c != EOF; c = fgetc(handle)) {
+    if (c != '\n') {
+      line.push_back((char)c);
+      continue;
+    }
+    
+    // `suite \t test`
+    if (line.find('\t') != std::string::npos)
+      passed.insert(line);
+    line.clear();
+  }
+  
+  fclose(handle);
+  return true;
+}
+
+bool NAMESPACE_EXPECT ResultCache::save() {
+  if (path.empty())
+    return false;
+  
+  // Write to a temporary file first so that an interrupted run never leaves a
+  // truncated cache behind
+  std::string temporary = std::string(path).append(".tmp");
+  FILE *handle = fopen(temporary.c_str(), "w");
+  if (handle == NULL)
+    return false;
+  
+  for (const std::string &key : passed)
+    fprintf(handle, "%s\n", key.c_str());
+  
+  if (fclose(handle) != 0) {
+    remove(temporary.c_str());
+    return false;
+  }
+  return rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool NAMESPACE_EXPECT ResultCache::cached(
+  Suite &suite,
+  Test  &test
+) {
+  return cacheable(test) && passed.count(cacheKey(suite, test)) > 0;
+}
+
+void NAMESPACE_EXPECT ResultCache::record(
+  Suite &suite  ,
+  Test  &test   ,
+  bool   success
+) {
+  if (success && cacheable(test))
+    passed.insert(cacheKey(suite, test));
+  else
+    passed.erase(cacheKey(suite, test));
+}
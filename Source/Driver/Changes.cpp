@@ -0,0 +1,170 @@
+// ===--- Changes.cpp -------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of selecting test cases by the source files that changed.   //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Driver/Changes.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#if defined(_WIN32)
+#define popen _popen
+#define pclose _pclose
+#endif
+
+/// Normalize the separators of a path and drop any leading `./` and `../`, so
+/// that paths relative to different directories can be compared.
+static std::string normalizePath(const char *path) {
+  std::string normalized = path;
+  for (char &c : normalized)
+    if (c == '\\')
+      c = '/';
+  while (normalized.compare(0, 2, "./") == 0 ||
+         normalized.compare(0, 3, "../") == 0)
+    normalized.erase(0, normalized[0] == '.' && normalized[1] == '/' ? 2 : 3);
+  return normalized;
+}
+
+bool NAMESPACE_EXPECT DependencyMap::load(const char *path) {
+  FILE *handle = fopen(path, "r");
+  if (handle == NULL)
+    return false;
+  
+  std::string line = "";
+  int c;
+  do {
+    c = fgetc(handle);
+    if (c != '\n' && c != EOF) {
+      line.push_back((char)c);
+      continue;
+    }
+    
+    // `file: dependent dependent ...`
+    size_t colon = line.find(": ");
+    if (colon == std::string::npos && !line.empty() && line.back() == ':')
+      colon = line.size() - 1;
+    if (!line.empty() && line[0] != '#' && colon != std::string::npos) {
+      std::vector<std::string> &files =
+        dependents[normalizePath(line.substr(0, colon).c_str())];
+      const char *next = line.c_str() + colon + 1;
+      while (*next != '\0') {
+        while (isspace((unsigned char)*next))
+          next++;
+        const char *end = next;
+        while (*end != '\0' && !isspace((unsigned char)*end))
+          end++;
+        if (end != next)
+          files.push_back(normalizePath(std::string(next, end).c_str()));
+        next = end;
+      }
+    }
+    line.clear();
+  } while (c != EOF);
+  
+  fclose(handle);
+  return true;
+}
+
+void NAMESPACE_EXPECT DependencyMap::extend(
+  std::vector<std::string> &files
+) const {
+  // Follow the dependencies breadth first, adding each file once
+  for (size_t i = 0; i < files.size(); i++)
+    for (auto &entry : dependents) {
+      if (!samePath(entry.first.c_str(), files[i].c_str()))
+        continue;
+      for (const std::string &dependent : entry.second) {
+        bool known = false;
+        for (const std::string &file : files)
+          if (samePath(file.c_str(), dependent.c_str())) {
+            known = true;
+            break;
+          }
+        if (!known)
+          files.push_back(dependent);
+      }
+    }
+}
+
+bool NAMESPACE_EXPECT samePath(
+  const char *lhs,
+  const char *rhs
+) {
+  std::string left = normalizePath(lhs), right = normalizePath(rhs);
+  if (left.size() < right.size())
+    std::swap(left, right);
+  if (right.empty())
+    return false;
+  
+  // The shorter path has to match whole directories at the end of the longer
+  size_t start = left.size() - right.size();
+  return left.compare(start, right.size(), right) == 0 &&
+    (start == 0 || left[start - 1] == '/');
+}
+
+bool NAMESPACE_EXPECT changedFiles(
+  const char               *revision,
+  std::vector<std::string> &files
+) {
+  // Quote the revision for the shell
+  std::string quoted = "'";
+  for (const char *c = revision; *c != '\0'; c++)
+    if (*c == '\'')
+      quoted.append("'\\''");
+    else
+      quoted.push_back(*c);
+  quoted.push_back('\'');
+  
+  std::string command = std::string(
+    "git -c core.quotePath=false diff --name-only ").append(quoted)
+    .append(" -- && git -c core.quotePath=false ls-files --others ")
+    .append("--exclude-standard --full-name");
+  FILE *handle = popen(command.c_str(), "r");
+  if (handle == NULL)
+    return false;
+  
+  std::string line = "";
+  for (int c = fgetc(handle); c != EOF; c = fgetc(handle))
+    if (c == '\n') {
+      if (!line.empty())
+        files.push_back(line);
+      line.clear();
+    } else {
+      line.push_back((char)c);
+    }
+  return pclose(handle) == 0;
+}
+
+size_t NAMESPACE_EXPECT enableTestsInFiles(
+  const std::vector<std::string> &files
+) {
+  size_t enabled = 0;
+  for (Suite *suite : suites())
+    for (Test &test : suite->tests) {
+      const char *file = test.file != nullptr ? test.file : suite->file;
+      if (file == nullptr)
+        continue;
+      
+      bool changed = false;
+      for (const std::string &changedFile : files)
+        if (samePath(file, changedFile.c_str())) {
+          changed = true;
+          break;
+        }
+      bool skip = false;
+      for (const char *tag : test.tags)
+        if (strcmp(tag, "benchmark") == 0 || strcmp(tag, "skip") == 0)
+          skip = true;
+      if (changed && !skip && !test.enabled) {
+        test.enabled = true;
+        enabled++;
+      }
+    }
+  return enabled;
+}
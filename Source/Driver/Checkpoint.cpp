@@ -0,0 +1,193 @@
+// ===--- Checkpoint.cpp ----------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of resuming interrupted test runs.                          //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Driver/Checkpoint.h>
+#include <Driver/Transport.h>
+#include <fcntl.h>
+#if defined(_WIN32)
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+/// Get the key of a test case in a checkpoint.
+static std::string checkpointKey(
+  NAMESPACE_EXPECT Suite &suite,
+  NAMESPACE_EXPECT Test  &test
+) {
+  return std::string(suite.name).append("\t").append(test.name);
+}
+
+bool NAMESPACE_EXPECT Checkpoint::load(const char *path) {
+  #if defined(_WIN32)
+  int journal = _open(path, _O_RDONLY | _O_BINARY);
+  #else
+  int journal = ::open(path, O_RDONLY);
+  #endif
+  length = 0;
+  if (journal < 0)
+    return false;
+  
+  // `suite`, `test`, `timed out`, `result`
+  std::string message;
+  while (receiveMessage(journal, message)) {
+    const char *data = message.data(), *end = data + message.size();
+    std::string suite, test;
+    uint64_t timedOut;
+    TestResult result { };
+    if (!readString(data, end, suite) || !readString(data, end, test) ||
+        !readInteger(data, end, timedOut) || !readResult(data, end, result))
+      break;
+    result.timedOut = timedOut != 0;
+    results[suite.append("\t").append(test)] = std::move(result);
+    length += 8 + (long long)message.size();
+  }
+  
+  #if defined(_WIN32)
+  _close(journal);
+  #else
+  ::close(journal);
+  #endif
+  return true;
+}
+
+bool NAMESPACE_EXPECT Checkpoint::open(
+  const char *path  ,
+  bool        resume
+) {
+  close();
+  #if defined(_WIN32)
+  file = _open(path, _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY,
+    _S_IREAD | _S_IWRITE);
+  #else
+  file = ::open(path, O_WRONLY | O_CREAT | O_APPEND, 0666);
+  #endif
+  if (file < 0)
+    return false;
+  
+  // Drop any entry cut short by an interruption, so that new entries follow
+  // on from the complete ones
+  #if defined(_WIN32)
+  _chsize(file, resume ? (long)length : 0);
+  #else
+  if (ftruncate(file, resume ? (off_t)length : 0) != 0) {
+    close();
+    return false;
+  }
+  #endif
+  return true;
+}
+
+void NAMESPACE_EXPECT Checkpoint::close() {
+  if (file < 0)
+    return;
+  #if defined(_WIN32)
+  _close(file);
+  #else
+  ::close(file);
+  #endif
+  file = -1;
+}
+
+const NAMESPACE_EXPECT TestResult *NAMESPACE_EXPECT Checkpoint::find(
+  Suite &suite,
+  Test  &test
+) const {
+  auto entry = results.find(checkpointKey(suite, test));
+  return entry == results.end() ? nullptr : &entry->second;
+}
+
+void NAMESPACE_EXPECT Checkpoint::record(
+  Suite            &suite ,
+  Test             &test  ,
+  const TestResult &result
+) {
+  if (file < 0)
+    return;
+  std::string message = { };
+  writeString(message, suite.name);
+  writeString(message, test.name);
+  writeInteger(message, result.timedOut);
+  writeResult(message, result);
+  sendMessage(file, message);
+}
+
+
+
+NAMESPACE_EXPECT Report NAMESPACE_EXPECT resumeTests(
+  std::vector<ScheduledTest>     &schedule  ,
+  Checkpoint                     &checkpoint,
+  std::function<void(RunState &)> state     ,
+  std::function<Report(
+    std::vector<ScheduledTest> &, std::function<void(RunState &)>)> run
+) {
+  Collector collector { schedule, state };
+  
+  // Only run the test cases that didn't finish
+  std::vector<ScheduledTest> remaining = { };
+  std::vector<size_t> positions = { };
+  for (size_t i = 0; i < schedule.size(); i++)
+    if (checkpoint.find(*schedule[i].suite, *schedule[i].test) == nullptr) {
+      remaining.push_back(schedule[i]);
+      positions.push_back(i);
+    }
+  
+  // Report the finished test cases along with the rest, in schedule order
+  for (size_t i = 0; i < schedule.size(); i++) {
+    const TestResult *result =
+      checkpoint.find(*schedule[i].suite, *schedule[i].test);
+    if (result != nullptr)
+      collector.finish(i, *result);
+  }
+  
+  // The remaining test cases are reported in their own schedule order, so
+  // the n-th test case reported is the n-th remaining test case
+  size_t next = 0;
+  Report report = run(remaining, [&](RunState &_state) -> void {
+    if (next >= remaining.size())
+      return;
+    ScheduledTest &scheduled = remaining[next];
+    
+    switch (_state.state) {
+    case RunState::State::RunningTest:
+      collector.start(positions[next]);
+      break;
+    
+    case RunState::State::TestSuccess: {
+      TestSuccess &success = (TestSuccess &)_state;
+      TestResult result { };
+      result.benchmarks = success.benchmarks;
+      result.time = success.time;
+      checkpoint.record(*scheduled.suite, *scheduled.test, result);
+      collector.finish(positions[next++], std::move(result));
+    } break;
+    
+    case RunState::State::TestFailed: {
+      TestFailed &failed = (TestFailed &)_state;
+      TestResult result { };
+      result.success = false;
+      result.failures = failed.failures;
+      result.time = failed.time;
+      result.timedOut = failed.timedOut;
+      checkpoint.record(*scheduled.suite, *scheduled.test, result);
+      collector.finish(positions[next++], std::move(result));
+    } break;
+    
+    default:
+      // Test suites are reported by the collector
+      break;
+    }
+  });
+  
+  Report resumed = collector.report();
+  resumed.isolationTime = report.isolationTime;
+  return resumed;
+}
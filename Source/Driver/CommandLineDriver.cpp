@@ -10,57 +10,286 @@
 
 #include <Driver/CommandLineDriver.h>
 #include <Driver/Driver.h>
+#include <Driver/ProcessDriver.h>
+#include <Driver/Coordinator.h>
+#include <Driver/History.h>
+#include <Driver/Cache.h>
+#include <Driver/Checkpoint.h>
+#include <Driver/Shard.h>
+#include <Driver/Daemon.h>
+#include <Driver/Plugins.h>
+#include <Driver/Changes.h>
+#include <Driver/Watch.h>
+#include <Driver/Transport.h>
+#include <Benchmarking/Family.h>
+#include <Suite/Index.h>
 #include <Suite/Suite.h>
 #include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <initializer_list>
+#include <chrono>
+#include <random>
+
+/// The client connection that command line output is sent to while serving a
+/// test run, or `-1` to print to standard output.
+static int commandLineOutput = -1;
+
+/// Print command line output.
+static void printOutput(const char *format, ...) {
+  va_list arguments;
+  va_start(arguments, format);
+  if (commandLineOutput < 0) {
+    vprintf(format, arguments);
+  } else {
+    char buffer[1024];
+    va_list copy;
+    va_copy(copy, arguments);
+    int size = vsnprintf(buffer, sizeof(buffer), format, copy);
+    va_end(copy);
+    std::string text = { };
+    if (size >= (int)sizeof(buffer)) {
+      text.resize(size + 1);
+      vsnprintf(&text[0], text.size(), format, arguments);
+      text.resize(size);
+    } else if (size > 0) {
+      text.assign(buffer, size);
+    }
+    NAMESPACE_EXPECT sendDaemonOutput(commandLineOutput, text);
+  }
+  va_end(arguments);
+}
 
 void displayHelp(const char *executable) {
-  printf(
+  printOutput(
     "Usage: %s [flags...] [test-names-or-suites...]\n"
     "\n"
     "Flags:\n"
     "  -h, --help        Display help.\n"
     "  -c, --continue    Continue after failed assertions.\n"
     "  --stop            Stop after failed assertions.\n"
+    "  -j, --jobs N      Run tests on N worker threads (0 for one per core).\n"
+    "  --fork            Run tests in forked worker processes instead of\n"
+    "                    threads, so that a crashing test fails on its own.\n"
+    "  --isolate         Like --fork, but run every test in a fresh process\n"
+    "                    forked from a worker with its suite already set up.\n"
+    "  --timeout MS      Fail tests that run for longer than MS milliseconds,\n"
+    "                    unless they have their own timeout(ms) tag.\n"
+    "  --benchmark-precision PERCENT\n"
+    "                    Stop benchmarks once their median is within PERCENT\n"
+    "                    at 95%% confidence, instead of running them for as\n"
+    "                    long as allowed.\n"
+    "  --benchmark-min-time MS, --benchmark-max-time MS\n"
+    "                    Run benchmarks for at least and at most MS\n"
+    "                    milliseconds (default: 0 and 1000).\n"
+    "  --benchmark-min-iterations N, --benchmark-max-iterations N\n"
+    "                    Run at least and at most N iterations of benchmarks\n"
+    "                    (default: 16 and 1024).\n"
+    "  --benchmark-counters\n"
+    "                    Collect hardware performance counters in benchmarks\n"
+    "                    where they are available.\n"
+    "  --rerun-failures N\n"
+    "                    Rerun each failed test N times at once in forked\n"
+    "                    workers after the run, to tell flaky tests from\n"
+    "                    broken ones.\n"
+    "  --history PATH    Record test times to PATH and use them to run the\n"
+    "                    longest tests first (default: <executable>.history).\n"
+    "  --no-history      Don't read or record test times.\n"
+    "  --failed-first    Run the tests that failed in the last run first.\n"
+    "  --shuffle         Run the suites and their tests in a random order,\n"
+    "                    printing the seed used.\n"
+    "  --seed N          Shuffle with the seed N, to replay a shuffled run\n"
+    "                    (implies --shuffle). Only the order of a serial or\n"
+    "                    threaded run can be replayed, not with --fork,\n"
+    "                    --isolate or --coordinate.\n"
+    "  --only-failed     Only run the tests that failed in the last run.\n"
+    "  --checkpoint PATH Journal finished tests to PATH as they finish\n"
+    "                    (default: <executable>.checkpoint).\n"
+    "  --no-checkpoint   Don't journal finished tests.\n"
+    "  --resume          Resume the journaled run, skipping and reporting the\n"
+    "                    tests that already finished.\n"
+    "  --cache DIR       Skip tests that already passed in this build of the\n"
+    "                    executable with the same flags, recording passed\n"
+    "                    tests in DIR.\n"
+    "  --shard-index I   Only run the tests in shard I (0-based).\n"
+    "  --shard-count N   Split the tests into N shards by a stable hash.\n"
+    "  --shard-balanced  Split the tests into shards of about equal total\n"
+    "                    time using the history given by --history, which\n"
+    "                    is only read.\n"
+    "  --list-shard      Print the shard of each test instead of running.\n"
+    "  --files LIST      Run the tests defined in the comma separated list of\n"
+    "                    source files.\n"
+    "  --changed-since REV\n"
+    "                    Run the tests defined in the source files that git\n"
+    "                    reports as changed since revision REV.\n"
+    "  --dependencies PATH\n"
+    "                    Also run the tests defined in the files that depend\n"
+    "                    on the selected files, as listed in the map at PATH.\n"
+    "  --serve PATH      Stay resident and serve test runs from clients on\n"
+    "                    the Unix socket at PATH.\n"
+    "  --coordinate ADDR Hand the tests out to worker processes connecting to\n"
+    "                    ADDR, a Unix socket path or tcp:[HOST:]PORT.\n"
+    "  --work ADDR       Run the tests handed out by the coordinator at ADDR.\n"
+    "  --plugins PATH    Load test suites from the plugins listed in the\n"
+    "                    manifest at PATH as they are selected\n"
+    "                    (default: <executable>.plugins).\n"
+    "  --watch           Rerun the tests whenever the executable changes,\n"
+    "                    failed tests first, only showing what changed.\n"
+    "  --watch-dir DIR   Also rerun the tests whenever anything in DIR\n"
+    "                    changes (implies --watch).\n"
     "\n"
     "Test Suites:\n"
   , executable);
-  std::vector<const char *> tags = { };
   for (NAMESPACE_EXPECT Suite *suite : NAMESPACE_EXPECT suites()) {
-    printf("  %s    Enable all tests in the suite.\n", suite->name);
+    printOutput("  %s    Enable all tests in the suite.\n", suite->name);
     for (NAMESPACE_EXPECT Test &test : suite->tests) {
-      printf("    %s    %s", test.name, test.description);
-      for (const char *tag : test.tags) {
-        bool exists = false;
-        for (const char *existingTag : tags)
-          if (strcmp(existingTag, tag) == 0) {
-            exists = true;
-            break;
-          }
-        if (!exists)
-          tags.push_back(tag);
-        printf(" (%s)", tag);
-      }
-      printf("\n");
+      printOutput("    %s    %s", test.name, test.description);
+      for (const char *tag : test.tags)
+        printOutput(" (%s)", tag);
+      printOutput("\n");
     }
   }
+  std::vector<const char *> &tags = NAMESPACE_EXPECT testIndex().tagNames;
   if (!tags.empty()) {
-    printf("\nTags:\n");
+    printOutput("\nTags:\n");
     for (const char *tag : tags) {
-      printf("  #%s\n", tag);
+      printOutput("  #%s\n", tag);
     }
   }
 }
 
+/// Match a command-line flag that takes a value, given either as
+/// `flag=value` or as `flag value`.
+bool flagValue(
+  int          argc ,
+  char        *argv[],
+  int         &i    ,
+  const char  *flag ,
+  const char *&value
+) {
+  size_t length = strlen(flag);
+  if (strncmp(argv[i], flag, length) != 0)
+    return false;
+  if (argv[i][length] == '=') {
+    value = argv[i] + length + 1;
+    return true;
+  } else if (argv[i][length] == '\0') {
+    value = i + 1 < argc ? argv[++i] : "";
+    return true;
+  }
+  return false;
+}
+
+/// Parse a benchmark time limit given in milliseconds, printing an error if it
+/// is invalid.
+bool benchmarkTime(
+  const char *value,
+  long long  &time
+) {
+  char *end;
+  long long milliseconds = strtoll(value, &end, 10);
+  if (*value == '\0' || *end != '\0' || milliseconds < 0) {
+    printOutput(
+      "Invalid benchmark time '%s'.\nUse '--help' for help.\n", value);
+    return false;
+  }
+  time = milliseconds * 1000000;
+  return true;
+}
+
+/// Parse a benchmark iteration limit, printing an error if it is invalid.
+bool benchmarkIterations(
+  const char *value,
+  size_t     &count
+) {
+  char *end;
+  unsigned long long iterations = strtoull(value, &end, 10);
+  if (*value == '\0' || *value == '-' || *end != '\0') {
+    printOutput(
+      "Invalid benchmark iteration count '%s'.\nUse '--help' for help.\n",
+      value);
+    return false;
+  }
+  count = (size_t)iterations;
+  return true;
+}
+
+/// Load the plugin manifest given with `--plugins`, or the one next to the
+/// executable.
+void loadPluginManifest(
+  int                              argc   ,
+  char                            *argv[] ,
+  NAMESPACE_EXPECT PluginManifest &plugins
+) {
+  std::string path = std::string(argv[0]).append(".plugins");
+  const char *value;
+  for (int i = 1; i < argc; i++)
+    if (flagValue(argc, argv, i, "--plugins", value))
+      path = value;
+  plugins.load(path.c_str());
+}
+
+/// Load every plugin in a plugin manifest, reporting any that fail to load.
+void loadAllPlugins(NAMESPACE_EXPECT PluginManifest &plugins) {
+  if (!plugins.loadAll())
+    printOutput("Unable to load a test plugin: %s\n", plugins.error.c_str());
+}
+
 
 int NAMESPACE_EXPECT runCommandLineTests(
   int   argc  ,
   char *argv[]
 ) {
+  const char *value;
+  for (int i = 1; i < argc; i++)
+    if (flagValue(argc, argv, i, "--serve", value))
+      return serveCommandLineTests(value, argv[0]);
+    else if (flagValue(argc, argv, i, "--work", value)) {
+      // Any test case may be handed out, so every plugin is needed
+      PluginManifest plugins { };
+      loadPluginManifest(argc, argv, plugins);
+      loadAllPlugins(plugins);
+      return runCoordinatedWorker(value);
+    }
+  return runCommandLineTests(argc, argv, -1);
+}
+
+int NAMESPACE_EXPECT runCommandLineTests(
+  int   argc  ,
+  char *argv[],
+  int   output
+) {
+  commandLineOutput = output;
   Environment environment { };
+  size_t jobs = 1, reruns = 0;
+  bool forkWorkers = false, isolate = false;
+  std::string historyPath = std::string(argv[0]).append(".history");
+  bool historyGiven = false;
+  std::string checkpointPath = std::string(argv[0]).append(".checkpoint");
+  bool resume = false;
+  size_t shardIndex = 0, shardCount = 0;
+  bool shardBalanced = false, listShard = false;
+  bool failedFirst = false, onlyFailed = false;
+  bool shuffle = false, seeded = false;
+  uint64_t seed = 0;
+  const char *cachePath = nullptr;
+  const char *coordinateAddress = nullptr;
+  std::vector<std::string> files = { };
+  const char *changedSince = nullptr, *dependenciesPath = nullptr;
+  bool watch = false;
+  std::vector<std::string> watchDirectories = { };
+  const char *value;
+  Suite *currentSuite = nullptr;
+  
+  // Test suites in plugins are only loaded once they are selected
+  PluginManifest plugins { };
+  loadPluginManifest(argc, argv, plugins);
   
   // Parse the command line arguments
   if (argc == 1) {
     // No arguments provided: display help
+    loadAllPlugins(plugins);
     displayHelp(argv[0]);
     return 0;
   }
@@ -70,6 +299,7 @@ int NAMESPACE_EXPECT runCommandLineTests(
       strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0
     ) {
       // Display help
+      loadAllPlugins(plugins);
       displayHelp(argv[0]);
       return 0;
     } else if (
@@ -80,109 +310,656 @@ int NAMESPACE_EXPECT runCommandLineTests(
       strcmp(argv[i], "--stop") == 0
     ) {
       environment.stopOnFailure = true;
+    } else if (
+      strcmp(argv[i], "--fork") == 0
+    ) {
+      forkWorkers = true;
+    } else if (
+      strcmp(argv[i], "--isolate") == 0
+    ) {
+      forkWorkers = true;
+      isolate = true;
+    } else if (
+      strcmp(argv[i], "--no-history") == 0
+    ) {
+      historyPath.clear();
+      historyGiven = false;
+    } else if (
+      flagValue(argc, argv, i, "--history", value)
+    ) {
+      historyPath = value;
+      historyGiven = true;
+    } else if (
+      strcmp(argv[i], "--failed-first") == 0
+    ) {
+      failedFirst = true;
+    } else if (
+      strcmp(argv[i], "--only-failed") == 0
+    ) {
+      onlyFailed = true;
+    } else if (
+      strcmp(argv[i], "--shuffle") == 0
+    ) {
+      shuffle = true;
+    } else if (
+      flagValue(argc, argv, i, "--seed", value)
+    ) {
+      char *end;
+      seed = strtoull(value, &end, 10);
+      if (*value == '\0' || *end != '\0') {
+        printOutput(
+          "Invalid seed '%s'.\nUse '--help' for help.\n", value);
+        return 1;
+      }
+      shuffle = seeded = true;
+    } else if (
+      strcmp(argv[i], "--no-checkpoint") == 0
+    ) {
+      checkpointPath.clear();
+    } else if (
+      flagValue(argc, argv, i, "--checkpoint", value)
+    ) {
+      checkpointPath = value;
+    } else if (
+      strcmp(argv[i], "--resume") == 0
+    ) {
+      resume = true;
+    } else if (
+      flagValue(argc, argv, i, "--cache", value)
+    ) {
+      cachePath = value;
+    } else if (
+      flagValue(argc, argv, i, "--files", value)
+    ) {
+      for (const char *end = value; *value != '\0'; value = end) {
+        end = strchr(value, ',');
+        if (end == nullptr)
+          end = value + strlen(value);
+        if (end != value)
+          files.push_back(std::string(value, end));
+        if (*end == ',')
+          end++;
+      }
+    } else if (
+      flagValue(argc, argv, i, "--changed-since", value)
+    ) {
+      changedSince = value;
+    } else if (
+      flagValue(argc, argv, i, "--dependencies", value)
+    ) {
+      dependenciesPath = value;
+    } else if (
+      strcmp(argv[i], "--watch") == 0
+    ) {
+      watch = true;
+    } else if (
+      flagValue(argc, argv, i, "--watch-dir", value)
+    ) {
+      watch = true;
+      watchDirectories.push_back(value);
+    } else if (
+      flagValue(argc, argv, i, "--plugins", value)
+    ) {
+      // Already loaded
+    } else if (
+      flagValue(argc, argv, i, "--coordinate", value)
+    ) {
+      coordinateAddress = value;
+    } else if (
+      strcmp(argv[i], "--shard-balanced") == 0
+    ) {
+      shardBalanced = true;
+    } else if (
+      strcmp(argv[i], "--list-shard") == 0
+    ) {
+      listShard = true;
+    } else if (
+      flagValue(argc, argv, i, "--shard-index", value)
+    ) {
+      char *end;
+      shardIndex = strtoul(value, &end, 10);
+      if (*value == '\0' || *end != '\0') {
+        printOutput(
+          "Invalid shard index '%s'.\nUse '--help' for help.\n", value);
+        return 1;
+      }
+    } else if (
+      flagValue(argc, argv, i, "--shard-count", value)
+    ) {
+      char *end;
+      shardCount = strtoul(value, &end, 10);
+      if (*value == '\0' || *end != '\0' || shardCount == 0) {
+        printOutput(
+          "Invalid shard count '%s'.\nUse '--help' for help.\n", value);
+        return 1;
+      }
+    } else if (
+      flagValue(argc, argv, i, "--timeout", value)
+    ) {
+      char *end;
+      environment.timeout = strtoll(value, &end, 10);
+      if (*value == '\0' || *end != '\0' || environment.timeout < 0) {
+        printOutput(
+          "Invalid timeout '%s'.\nUse '--help' for help.\n", value);
+        return 1;
+      }
+    } else if (
+      flagValue(argc, argv, i, "--benchmark-precision", value)
+    ) {
+      char *end;
+      double percent = strtod(value, &end);
+      if (*value == '\0' || *end != '\0' || !(percent >= 0)) {
+        printOutput(
+          "Invalid benchmark precision '%s'.\nUse '--help' for help.\n",
+          value);
+        return 1;
+      }
+      environment.benchmarking.precision = percent / 100;
+    } else if (
+      strcmp(argv[i], "--benchmark-counters") == 0
+    ) {
+      environment.benchmarking.counters = true;
+    } else if (
+      flagValue(argc, argv, i, "--benchmark-min-time", value)
+    ) {
+      if (!benchmarkTime(value, environment.benchmarking.minTime))
+        return 1;
+    } else if (
+      flagValue(argc, argv, i, "--benchmark-max-time", value)
+    ) {
+      if (!benchmarkTime(value, environment.benchmarking.maxTime))
+        return 1;
+    } else if (
+      flagValue(argc, argv, i, "--benchmark-min-iterations", value)
+    ) {
+      if (!benchmarkIterations(value, environment.benchmarking.minIterations))
+        return 1;
+    } else if (
+      flagValue(argc, argv, i, "--benchmark-max-iterations", value)
+    ) {
+      if (!benchmarkIterations(value, environment.benchmarking.maxIterations))
+        return 1;
+    } else if (
+      flagValue(argc, argv, i, "--rerun-failures", value)
+    ) {
+      char *end;
+      reruns = strtoul(value, &end, 10);
+      if (*value == '\0' || *end != '\0') {
+        printOutput(
+          "Invalid rerun count '%s'.\nUse '--help' for help.\n", value);
+        return 1;
+      }
+    } else if (
+      flagValue(argc, argv, i, "--jobs", value) ||
+      flagValue(argc, argv, i, "-j", value)
+    ) {
+      char *end;
+      jobs = strtoul(value, &end, 10);
+      if (*value == '\0' || *end != '\0') {
+        printOutput(
+          "Invalid job count '%s'.\nUse '--help' for help.\n", value);
+        return 1;
+      }
     } else if (argv[i][0] == '#') {
-      // Tag
-      bool found = false;
-      for (Suite *suite : suites())
-        for (Test &test : suite->tests)
-          for (const char *tag : test.tags)
-            if (strcmp(tag, argv[i] + 1) == 0) {
-              test.enabled = true;
-              found = true;
-            }
-      if (!found) {
-        printf("Unknown tag '%s'.\nUse '--help' for help.\n", argv[i]);
+      // Tag, which may be used by test cases in any plugin
+      loadAllPlugins(plugins);
+      auto tagged = testIndex().tags.find(argv[i] + 1);
+      if (tagged != testIndex().tags.end()) {
+        for (Test *test : tagged->second)
+          test->enabled = true;
+      } else {
+        printOutput("Unknown tag '%s'.\nUse '--help' for help.\n", argv[i]);
         return 1;
       }
     } else {
       // Test suites
-      bool found = false;
-      for (Suite *suite : suites())
-        if (strcmp(argv[i], suite->name) == 0) {
-          // Enable all tests in the suite not marked 'benchmark' or 'skip'
-          for (Test &test : suite->tests) {
-            bool skip = false;
-            for (const char *tag : test.tags)
-              if (strcmp(tag, "benchmark") == 0 || strcmp(tag, "skip") == 0) {
-                skip = true;
-                break;
-              }
-            if (!skip)
-              test.enabled = true;
-          }
-          found = true;
-          break;
-        } else {
-          for (Test &test : suite->tests)
-            if (strcmp(argv[i], test.name) == 0) {
-              // Enable the individual test
-              test.enabled = true;
-              found = true;
+      Suite *suite;
+      Test *test;
+      if (!testIndex().find(argv[i], suite, test)) {
+        // Load the plugin holding the test suite, or every plugin if it
+        // doesn't name a test suite in the manifest, since any of them may
+        // hold the test case
+        if (!plugins.loadSuite(argv[i])) {
+          if (!plugins.error.empty())
+            printOutput("Unable to load a test plugin: %s\n",
+              plugins.error.c_str());
+          loadAllPlugins(plugins);
+        }
+        testIndex().find(argv[i], suite, test);
+      }
+      if (suite != nullptr) {
+        // Enable all tests in the suite not marked 'benchmark' or 'skip'
+        for (Test &test : suite->tests) {
+          bool skip = false;
+          for (const char *tag : test.tags)
+            if (strcmp(tag, "benchmark") == 0 || strcmp(tag, "skip") == 0) {
+              skip = true;
               break;
             }
-          if (found)
-            break;
+          if (!skip)
+            test.enabled = true;
         }
-      if (!found) {
-        printf("Unknown flag or test name '%s'.\nUse '--help' for help.\n", argv[i]);
+      } else if (test != nullptr) {
+        // Enable the individual test
+        test->enabled = true;
+      } else {
+        printOutput("Unknown flag or test name '%s'.\nUse '--help' for help.\n", argv[i]);
         return 1;
       }
     }
   
+  // Select the tests defined in the given files and the files that changed,
+  // along with the files that depend on them
+  if (!files.empty() || changedSince != nullptr) {
+    if (changedSince != nullptr && !changedFiles(changedSince, files)) {
+      printOutput("Unable to list the files changed since '%s'.\n",
+        changedSince);
+      return 1;
+    }
+    DependencyMap dependencies { };
+    if (dependenciesPath != nullptr) {
+      if (!dependencies.load(dependenciesPath)) {
+        printOutput("Unable to read the dependencies in '%s'.\n",
+          dependenciesPath);
+        return 1;
+      }
+      dependencies.extend(files);
+    }
+    loadAllPlugins(plugins);
+    size_t enabled = enableTestsInFiles(files);
+    printOutput("\nSelected %zu tests defined in %zu files.\n",
+      enabled, files.size());
+  }
+  
+  // Balanced shards are only assigned alike by every shard if they all read
+  // the same history, which none of them may change
+  if (shardBalanced && !historyGiven) {
+    printOutput(
+      "--shard-balanced needs a shared history file given with --history.\n"
+      "Use '--help' for help.\n");
+    return 1;
+  }
+  
+  // Estimate how long each test will take from the previous runs
+  History history { };
+  if (!historyPath.empty())
+    history.load(historyPath.c_str());
+  std::vector<ScheduledTest> schedule = enabledTests();
+  history.estimate(schedule);
+  
+  // Only keep the tests that failed in the last run, out of every test if
+  // none were selected
+  if (onlyFailed) {
+    if (schedule.empty()) {
+      loadAllPlugins(plugins);
+      for (Suite *suite : suites())
+        for (Test &test : suite->tests)
+          test.enabled = true;
+      schedule = enabledTests();
+      history.estimate(schedule);
+    }
+    std::vector<ScheduledTest> failed = { };
+    for (ScheduledTest &scheduled : schedule)
+      if (history.failed(*scheduled.suite, *scheduled.test))
+        failed.push_back(scheduled);
+    schedule = failed;
+  }
+  
+  // Only keep the tests in our shard
+  if (shardCount > 0 || listShard) {
+    if (shardCount == 0)
+      shardCount = 1;
+    if (shardIndex >= shardCount) {
+      printOutput("Shard index %zu is out of range for %zu shards.\n",
+        shardIndex, shardCount);
+      return 1;
+    }
+    
+    std::vector<size_t> shards =
+      assignShards(schedule, shardCount, shardBalanced);
+    if (listShard) {
+      for (size_t shard = 0; shard < shardCount; shard++) {
+        long long time = 0;
+        size_t count = 0;
+        for (size_t i = 0; i < schedule.size(); i++)
+          if (shards[i] == shard) {
+            time += std::max(schedule[i].time, 0ll);
+            count++;
+          }
+        printOutput("%sShard %zu: %zu tests, %.3f s expected\n",
+          shard == shardIndex ? "* " : "  ", shard, count, time / 1e9);
+        for (size_t i = 0; i < schedule.size(); i++)
+          if (shards[i] == shard)
+            printOutput("    %s %s\n", schedule[i].suite->name,
+              schedule[i].test->name);
+      }
+      return 0;
+    }
+    
+    std::vector<ScheduledTest> shard = { };
+    for (size_t i = 0; i < schedule.size(); i++)
+      if (shards[i] == shardIndex)
+        shard.push_back(schedule[i]);
+    schedule = shard;
+  }
+  
+  // Skip the tests that already passed in this build
+  ResultCache cache { };
+  size_t cached = 0;
+  if (cachePath != nullptr) {
+    // Rebuilt plugins change the identifier of the build too
+    std::vector<std::string> loaded = { };
+    for (size_t i = 0; i < plugins.plugins.size(); i++)
+      if (plugins.loaded[i])
+        loaded.push_back(plugins.plugins[i]);
+    if (cache.open(cachePath, argv[0], loaded, environment)) {
+      std::vector<ScheduledTest> uncached = { };
+      for (ScheduledTest &scheduled : schedule)
+        if (cache.cached(*scheduled.suite, *scheduled.test)) {
+          if (cached++ == 0)
+            printOutput("\nCached tests that already passed in this build:\n");
+          printOutput("  %s %s\n", scheduled.suite->name,
+            scheduled.test->name);
+        } else {
+          uncached.push_back(scheduled);
+        }
+      schedule = uncached;
+    } else {
+      printOutput("\nUnable to use the test result cache in '%s'.\n",
+        cachePath);
+      cachePath = nullptr;
+    }
+  }
+  
+  // Run the tests that failed in the last run before the rest
+  if (failedFirst)
+    history.prioritize(schedule);
+  
+  // Shuffle the tests, so that only the seed decides their order
+  if (shuffle) {
+    if (!seeded)
+      seed = ((uint64_t)std::random_device()() << 32) ^ (uint64_t)
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    shuffleTests(schedule, seed);
+    environment.pinned = true;
+    printOutput("\nShuffling tests with seed %llu (replay with --seed %llu).\n",
+      (unsigned long long)seed, (unsigned long long)seed);
+  }
+  
+  // Watch for changes from before the tests run, so that a rebuild during the
+  // run is noticed as soon as it finishes, but not the files that the run
+  // writes itself, which would trigger another run
+  Watcher watcher { };
+  if (output >= 0)
+    watch = false;
+  std::vector<std::string> written = { };
+  for (const std::string &path : { historyPath, checkpointPath })
+    if (!path.empty())
+      written.push_back(path);
+  if (cachePath != nullptr)
+    written.push_back(cachePath);
+  if (watch && !watcher.open(argv[0], watchDirectories, written)) {
+    printOutput("\nUnable to watch '%s' for changes.\n", argv[0]);
+    watch = false;
+  }
+  
+  // When rerunning for a change, only show the tests whose outcome changed
+  // since the last run
+  bool delta = watch && !historyPath.empty() &&
+    getenv("EXPECT_WATCH_RERUN") != nullptr;
+  size_t changed = 0;
+  if (delta)
+    printOutput("\nRerunning %zu tests.\n", schedule.size());
+  
   // Run all tests
-  Report report = RUN_ENABLED_TESTS(environment, state) {
+  std::function<void(RunState &)> display = [&](RunState &state) -> void {
+    if (state.state == RunState::State::RunningSuite)
+      currentSuite = &((RunningSuite &)state).suite;
+    else if (state.state == RunState::State::FinishedSuite)
+      currentSuite = &((FinishedSuite &)state).suite;
+    else if (state.state == RunState::State::RunningTest)
+      currentSuite = &((RunningTest &)state).suite;
+    if (output >= 0)
+      sendDaemonEvent(output, state, *currentSuite);
+    
     switch (state.state) {
     case RunState::State::RunningSuite: {
+      if (delta)
+        break;
       RunningSuite &suite = (RunningSuite &)state;
-      printf("\nRunning test suite %s.\n", suite.suite.name);
+      printOutput("\nRunning test suite %s.\n", suite.suite.name);
     } break;
     
     case RunState::State::FinishedSuite: {
+      if (delta)
+        break;
       FinishedSuite &suite = (FinishedSuite &)state;
-      printf("Successful: %zu/%zu\n", suite.successful, suite.count);
+      printOutput("Successful: %zu/%zu\n", suite.successful, suite.count);
     } break;
     
     case RunState::State::RunningTest: {
+      if (delta)
+        break;
       RunningTest &test = (RunningTest &)state;
-      printf("  Running test %s (%zu/%zu) ... ", test.test.name, test.index, test.count);
+      printOutput("  Running test %s (%zu/%zu) ... ", test.test.name, test.index, test.count);
       fflush(stdout);
     } break;
     
     case RunState::State::TestSuccess: {
       TestSuccess &success = (TestSuccess &)state;
-      printf("success.\n");
+      bool fixed = history.failed(*currentSuite, success.test);
+      history.record(*currentSuite, success.test, success.time);
+      cache.record(*currentSuite, success.test, true);
+      if (delta) {
+        if (fixed) {
+          changed++;
+          printOutput("  Now passing: %s %s\n", currentSuite->name,
+            success.test.name);
+        }
+        break;
+      }
+      printOutput("success.\n");
       for (BenchmarkResult &benchmark : success.benchmarks) {
-        printf(
-          "    Benchmark results on line %d:\n"
+        printOutput("    Benchmark results on line %d", benchmark.line);
+        for (size_t i = 0; i < benchmark.parameters.size(); i++)
+          printOutput("%s%s = %lld", i == 0 ? " (" : ", ",
+            benchmark.parameters[i].name.c_str(),
+            benchmark.parameters[i].value);
+        printOutput(
+          "%s:\n"
           "        Iterations: %zu\n"
+          "        Batch size: %zu\n"
           "        Total time: %lld (ns)\n"
-          "         Mean time: %lld (ns)\n"
+          "         Mean time: %.2f (ns)\n"
           "      Distribution: min -[Q1 - median - Q3]- max\n"
-          "        %lld -[%lld - %lld - %lld]- %lld (ns)\n"
+          "        %.2f -[%.2f - %.2f - %.2f]- %.2f (ns)\n"
+          "  Median precision: +/-%.2f%% (95%% confidence)\n"
         ,
-          benchmark.line,
+          benchmark.parameters.empty() ? "" : ")",
           benchmark.iterations,
+          benchmark.batch,
           benchmark.totalTime,
           benchmark.meanTime,
           benchmark.minTime, benchmark.q1Time, benchmark.medianTime,
-            benchmark.q3Time, benchmark.maxTime
+            benchmark.q3Time, benchmark.maxTime,
+          benchmark.precision * 100
+        );
+        if (benchmark.allocations >= 0)
+          printOutput(
+            "       Allocations: %.2f per run, %.2f bytes per run,\n"
+            "                    %lld bytes at peak\n",
+            benchmark.allocations, benchmark.allocatedBytes,
+            benchmark.peakBytes);
+        if (benchmark.cycles >= 0 || benchmark.instructions >= 0) {
+          printOutput("  Counters per run:");
+          const char *names[] = {
+            "cycles", "instructions", "branch misses", "L1d misses",
+            "LLC misses", "dTLB misses"
+          };
+          double counters[] = {
+            benchmark.cycles, benchmark.instructions, benchmark.branchMisses,
+            benchmark.l1dMisses, benchmark.llcMisses, benchmark.dtlbMisses
+          };
+          for (size_t i = 0; i < sizeof(counters) / sizeof(double); i++)
+            if (counters[i] >= 0)
+              printOutput("\n        %.2f %s", counters[i], names[i]);
+          if (benchmark.ipc >= 0)
+            printOutput("\n        %.2f instructions per cycle", benchmark.ipc);
+          printOutput("\n");
+        }
+      }
+      for (ComplexityFit &fit : fitComplexity(success.benchmarks)) {
+        printOutput("    Complexity on line %d", fit.line);
+        for (size_t i = 0; i < fit.parameters.size(); i++)
+          printOutput("%s%s = %lld", i == 0 ? " (" : ", ",
+            fit.parameters[i].name.c_str(), fit.parameters[i].value);
+        printOutput(
+          "%s over %s:\n"
+          "        %s with a coefficient of %.4g (ns),\n"
+          "        %.2f%% RMS error over %zu points\n"
+        ,
+          fit.parameters.empty() ? "" : ")",
+          fit.name.c_str(),
+          complexityName(fit.complexity),
+          fit.coefficient,
+          fit.rms * 100,
+          fit.points
         );
       }
     } break;
     
     case RunState::State::TestFailed: {
       TestFailed &failed = (TestFailed &)state;
-      printf("failure.\n");
+      bool broken = !history.failed(*currentSuite, failed.test);
+      history.record(*currentSuite, failed.test, failed.time, true);
+      cache.record(*currentSuite, failed.test, false);
+      if (delta) {
+        if (!broken)
+          break;
+        changed++;
+        printOutput("  Now failing: %s %s\n", currentSuite->name,
+          failed.test.name);
+      } else {
+        printOutput("failure.\n");
+      }
       for (Failure &fail : failed.failures)
-        printf("    %s\n", fail.message.c_str());
+        printOutput("    %s\n", fail.message.c_str());
     } break;
     }
   };
+  std::function<Report(
+    std::vector<ScheduledTest> &, std::function<void(RunState &)>)> run = [&](
+    std::vector<ScheduledTest>     &schedule,
+    std::function<void(RunState &)> state
+  ) -> Report {
+    if (coordinateAddress != nullptr) {
+      printOutput("\nWaiting for workers on '%s'.\n", coordinateAddress);
+      fflush(stdout);
+      return runCoordinatedTests(
+        environment, schedule, coordinateAddress, state);
+    }
+    return forkWorkers ?
+      runForkedTests(environment, schedule, jobs, state, isolate) :
+      runTests(environment, schedule, jobs, state);
+  };
+  
+  // Journal the tests as they finish, picking up where the journaled run left
+  // off when resuming
+  Checkpoint checkpoint { };
+  if (!checkpointPath.empty()) {
+    if (resume && !checkpoint.load(checkpointPath.c_str()))
+      printOutput("\nNo test run to resume in '%s'.\n",
+        checkpointPath.c_str());
+    if (!checkpoint.open(checkpointPath.c_str(), resume))
+      printOutput("\nUnable to write the test checkpoint to '%s'.\n",
+        checkpointPath.c_str());
+  }
+  std::function<Report(
+    std::vector<ScheduledTest> &, std::function<void(RunState &)>)> journal =
+    [&](
+      std::vector<ScheduledTest>     &schedule,
+      std::function<void(RunState &)> state
+    ) -> Report {
+      return checkpointPath.empty() ?
+        run(schedule, state) :
+        resumeTests(schedule, checkpoint, state, run);
+    };
+  
+  // Rerun the tests that fail to tell flaky tests from broken ones
+  size_t rerunFailed = 0;
+  Report report = reruns > 0 ?
+    rerunFailures(environment, schedule, reruns, display,
+      [&](Suite &suite, Test &test, size_t passed) -> void {
+        if (rerunFailed++ == 0)
+          printOutput("\nRerunning each failed test %zu times:\n", reruns);
+        printOutput("  %s %s: %s, passed %zu/%zu reruns.\n", suite.name,
+          test.name, passed > 0 ? "flaky" : "deterministic", passed, reruns);
+        fflush(stdout);
+      }, journal) :
+    journal(schedule, display);
+  checkpoint.close();
+  
+  // Record how long each test took for the next run
+  if (!historyPath.empty() && !shardBalanced &&
+      !history.save(historyPath.c_str()))
+    printOutput("\nUnable to write the test history to '%s'.\n",
+      historyPath.c_str());
+  
+  // Record which tests passed for the next run of this build
+  if (cachePath != nullptr && !cache.save())
+    printOutput("\nUnable to write the test result cache to '%s'.\n",
+      cache.path.c_str());
   
   // Finish
+  if (delta && changed == 0)
+    printOutput("\nNo tests changed outcome.\n");
   if (report.isSuccessful)
-    printf("\nAll tests passed.\n");
+    printOutput("\nAll tests passed.\n");
   else
-    printf("\n%zu tests failed.\n", report.totalFailed);
+    printOutput("\n%zu tests failed.\n", report.totalFailed);
+  if (cached > 0)
+    printOutput("%zu tests were cached.\n", cached);
+  if (report.totalTimedOut > 0)
+    printOutput("%zu tests timed out.\n", report.totalTimedOut);
+  if (reruns > 0 && !report.isSuccessful)
+    printOutput(
+      "%zu failed tests were flaky and %zu failed deterministically.\n",
+      report.totalFlaky, report.totalDeterministic);
+  if (shuffle && !report.isSuccessful)
+    printOutput("Tests were shuffled with seed %llu.\n",
+      (unsigned long long)seed);
+  if (isolate && coordinateAddress == nullptr && report.total > 0)
+    printOutput("Isolating %zu tests added %.3f ms (%.1f us per test).\n",
+      report.total, report.isolationTime / 1e6,
+      report.isolationTime / 1e3 / report.total);
+  
+  // Rerun the same selection whenever something changes, which also leaves
+  // behind any threads stuck in timed out tests
+  if (watch) {
+    printOutput("\nWatching for changes.\n");
+    fflush(stdout);
+    while (watcher.wait(200)) {
+      rerunTests(argc, argv);
+      printOutput("\nUnable to rerun '%s', waiting for the next change.\n",
+        argv[0]);
+      fflush(stdout);
+    }
+    printOutput("\nUnable to watch '%s' for changes.\n", argv[0]);
+    return 1;
+  }
+  
+  // Threads stuck in timed out tests can't be stopped, and would otherwise be
+  // torn down along with the rest of the process while still running
+  if (report.totalTimedOut > 0 && !forkWorkers) {
+    fflush(stdout);
+    fflush(stderr);
+    if (output >= 0) {
+      std::string reply = { };
+      writeInteger(reply, (uint64_t)DaemonMessage::Finished);
+      writeInteger(reply, 0);
+      sendMessage(output, reply);
+    }
+    _Exit(0);
+  }
   return 0;
 }
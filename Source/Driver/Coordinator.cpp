@@ -0,0 +1,460 @@
+// ===--- Coordinator.cpp ---------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of handing test cases out to worker processes over sockets. //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Driver/Coordinator.h>
+#include <Driver/Transport.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <stdio.h>
+#include <string.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#define _EXPECT_COORDINATE 1
+#endif
+
+/// The most test cases handed to a worker process at once.
+#define _EXPECT_MAX_BATCH 64
+
+#if _EXPECT_COORDINATE
+
+/// A worker process connected to the coordinator.
+struct CoordinatedWorker {
+  /// The connection to the worker.
+  int socket = -1;
+  /// The indices of the test cases in the batch that the worker is running.
+  std::vector<size_t> batch { };
+  /// The number of test cases in the batch that have finished.
+  size_t done = 0;
+  /// When the worker started the test case that it is running.
+  std::chrono::steady_clock::time_point start;
+  /// The time limit of the test case, in milliseconds, or `0` for no limit.
+  long long limit = 0;
+  
+  /// Get whether or not the worker is running a test case.
+  bool busy() const { return done < batch.size(); }
+};
+
+/// Open a socket for a coordinator address.
+/// \param[in] address
+///   The address of the coordinator.
+/// \param[in] server
+///   Whether to listen on the address instead of connecting to it.
+/// \returns
+///   The socket, or `-1` if it couldn't be opened.
+static int coordinatorSocket(const char *address, bool server) {
+  if (strncmp(address, "tcp:", 4) != 0) {
+    // Unix socket
+    sockaddr_un local { };
+    local.sun_family = AF_UNIX;
+    if (strlen(address) >= sizeof(local.sun_path)) {
+      fprintf(stderr, "Socket path '%s' is too long.\n", address);
+      return -1;
+    }
+    strcpy(local.sun_path, address);
+    
+    int file = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (file < 0) {
+      fprintf(stderr, "Unable to create a socket: %s\n", strerror(errno));
+      return -1;
+    }
+    if (server && !NAMESPACE_EXPECT clearSocketPath(address)) {
+      close(file);
+      return -1;
+    }
+    if (server ?
+        bind(file, (sockaddr *)&local, sizeof(local)) != 0 ||
+          listen(file, 64) != 0 :
+        connect(file, (sockaddr *)&local, sizeof(local)) != 0) {
+      fprintf(stderr, "Unable to %s '%s': %s\n",
+        server ? "listen on" : "connect to", address, strerror(errno));
+      close(file);
+      return -1;
+    }
+    return file;
+  }
+  
+  // TCP socket, on the loopback interface unless a host is given
+  std::string host = "127.0.0.1", port = address + 4;
+  size_t colon = port.rfind(':');
+  if (colon != std::string::npos) {
+    host = port.substr(0, colon);
+    port = port.substr(colon + 1);
+  }
+  addrinfo hints { };
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *found = nullptr;
+  int error = getaddrinfo(host.c_str(), port.c_str(), &hints, &found);
+  if (error != 0) {
+    fprintf(stderr, "Unable to resolve '%s': %s\n", address,
+      gai_strerror(error));
+    return -1;
+  }
+  
+  int file = -1;
+  for (addrinfo *entry = found; entry != nullptr; entry = entry->ai_next) {
+    file = socket(entry->ai_family, entry->ai_socktype, entry->ai_protocol);
+    if (file < 0)
+      continue;
+    int on = 1;
+    setsockopt(file, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    if (server)
+      setsockopt(file, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (server ?
+        bind(file, entry->ai_addr, entry->ai_addrlen) == 0 &&
+          listen(file, 64) == 0 :
+        connect(file, entry->ai_addr, entry->ai_addrlen) == 0)
+      break;
+    close(file);
+    file = -1;
+  }
+  if (file < 0)
+    fprintf(stderr, "Unable to %s '%s': %s\n",
+      server ? "listen on" : "connect to", address, strerror(errno));
+  freeaddrinfo(found);
+  return file;
+}
+
+/// Fail the test case that a worker process is running and hand the rest of
+/// its batch out again, then disconnect the worker.
+static void dropCoordinatedWorker(
+  CoordinatedWorker              &worker   ,
+  std::deque<size_t>             &pending  ,
+  NAMESPACE_EXPECT Collector     &collector,
+  NAMESPACE_EXPECT TestResult     result   ,
+  size_t                         &finished
+) {
+  if (worker.busy()) {
+    for (size_t i = worker.batch.size(); i-- > worker.done + 1; )
+      pending.push_front(worker.batch[i]);
+    finished++;
+    collector.finish(worker.batch[worker.done], std::move(result));
+  }
+  close(worker.socket);
+  worker.socket = -1;
+  worker.batch.clear();
+  worker.done = 0;
+}
+
+#endif
+
+
+
+NAMESPACE_EXPECT Report NAMESPACE_EXPECT runCoordinatedTests(
+  Environment                    &environment,
+  std::vector<ScheduledTest>     &schedule   ,
+  const char                     *address    ,
+  std::function<void(RunState &)> state
+) {
+#if _EXPECT_COORDINATE
+  Collector collector { schedule, state };
+  if (schedule.empty())
+    return collector.report();
+  
+  // None of the test cases can run without a socket to hand them out on
+  int server = coordinatorSocket(address, true);
+  if (server < 0)
+    return Report { 0, schedule.size() };
+  
+  // A worker that goes away must not take the coordinator with it
+  void (*lastPipeHandler)(int) = signal(SIGPIPE, SIG_IGN);
+  
+  // Hand out the longest test cases first
+  std::vector<size_t> order = dispatchOrder(schedule);
+  std::deque<size_t> pending(order.begin(), order.end());
+  std::vector<CoordinatedWorker> workers = { };
+  size_t finished = 0;
+  
+  std::string hello = { };
+  writeInteger(hello, environment.stopOnFailure);
+  writeInteger(hello, (uint64_t)environment.timeout);
+  writeDouble(hello, environment.benchmarking.precision);
+  writeInteger(hello, environment.benchmarking.minIterations);
+  writeInteger(hello, environment.benchmarking.maxIterations);
+  writeInteger(hello, (uint64_t)environment.benchmarking.minTime);
+  writeInteger(hello, (uint64_t)environment.benchmarking.maxTime);
+  writeInteger(hello, environment.benchmarking.counters);
+  
+  while (finished < schedule.size()) {
+    // Forget the workers that were dropped
+    workers.erase(std::remove_if(workers.begin(), workers.end(),
+      [](const CoordinatedWorker &worker) -> bool {
+        return worker.socket < 0;
+      }), workers.end());
+    
+    // Hand out batches to idle workers, smaller as the queue runs out
+    size_t connected = workers.size();
+    for (CoordinatedWorker &worker : workers) {
+      if (pending.empty())
+        break;
+      if (worker.socket < 0 || worker.busy())
+        continue;
+      
+      size_t size = std::max<size_t>(std::min<size_t>(
+        pending.size() / (2 * connected), _EXPECT_MAX_BATCH), 1);
+      std::string message = { };
+      writeInteger(message, size);
+      worker.batch.clear();
+      worker.done = 0;
+      for (size_t i = 0; i < size; i++) {
+        size_t index = pending.front();
+        pending.pop_front();
+        worker.batch.push_back(index);
+        writeInteger(message, index);
+        writeString(message, schedule[index].suite->name);
+        writeString(message, schedule[index].test->name);
+      }
+      if (!sendMessage(worker.socket, message)) {
+        // The worker went away before it was handed the batch: hand the whole
+        // batch out again, since none of it ran
+        for (size_t i = worker.batch.size(); i-- > 0; )
+          pending.push_front(worker.batch[i]);
+        worker.batch.clear();
+        dropCoordinatedWorker(
+          worker, pending, collector, TestResult { }, finished);
+        continue;
+      }
+      worker.start = std::chrono::steady_clock::now();
+      worker.limit =
+        schedule[worker.batch[0]].test->timeLimit(environment.timeout);
+      collector.start(worker.batch[0]);
+    }
+    
+    // Wait for new workers and results
+    std::vector<pollfd> files = { pollfd { server, POLLIN, 0 } };
+    std::vector<size_t> polled = { };
+    for (size_t i = 0; i < workers.size(); i++)
+      if (workers[i].socket >= 0) {
+        files.push_back(pollfd { workers[i].socket, POLLIN, 0 });
+        polled.push_back(i);
+      }
+    
+    // Wake up in time for the nearest time limit
+    int timeout = -1;
+    auto now = std::chrono::steady_clock::now();
+    for (CoordinatedWorker &worker : workers)
+      if (worker.socket >= 0 && worker.busy() && worker.limit > 0) {
+        auto deadline = worker.start + std::chrono::milliseconds(worker.limit);
+        long long remaining = std::max(0ll, (long long)
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - now).count() + 1);
+        if (timeout < 0 || remaining < timeout)
+          timeout = (int)std::min(remaining, 1ll << 30);
+      }
+    if (poll(files.data(), files.size(), timeout) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    
+    // Welcome new workers
+    if (files[0].revents != 0) {
+      int client = accept(server, nullptr, nullptr);
+      if (client >= 0 && sendMessage(client, hello)) {
+        CoordinatedWorker worker { };
+        worker.socket = client;
+        workers.push_back(worker);
+      } else if (client >= 0) {
+        close(client);
+      }
+    }
+    
+    for (size_t i = 1; i < files.size(); i++) {
+      if (files[i].revents == 0)
+        continue;
+      CoordinatedWorker &worker = workers[polled[i - 1]];
+      
+      std::string message;
+      uint64_t index;
+      TestResult result { };
+      const char *data = nullptr;
+      if (receiveMessage(worker.socket, message) && worker.busy() &&
+          (data = message.data(),
+            readInteger(data, data + message.size(), index)) &&
+          index == worker.batch[worker.done] &&
+          readResult(data, message.data() + message.size(), result)) {
+        finished++;
+        collector.finish(worker.batch[worker.done++], std::move(result));
+        
+        // Start timing the next test case in the batch
+        if (worker.busy()) {
+          worker.start = std::chrono::steady_clock::now();
+          worker.limit = schedule[worker.batch[worker.done]].test->timeLimit(
+            environment.timeout);
+          collector.start(worker.batch[worker.done]);
+        }
+      } else {
+        // The worker died or misbehaved: fail its test and hand the rest of
+        // its batch to the other workers
+        result = TestResult { };
+        result.success = false;
+        result.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - worker.start).count();
+        result.failures.push_back(Failure {
+          "Worker process disconnected while running the test."
+        });
+        dropCoordinatedWorker(worker, pending, collector, result, finished);
+      }
+    }
+    
+    // Give up on the workers whose test case ran out of time, which can't be
+    // stopped from here
+    now = std::chrono::steady_clock::now();
+    for (CoordinatedWorker &worker : workers) {
+      if (worker.socket < 0 || !worker.busy() || worker.limit <= 0 ||
+          now < worker.start + std::chrono::milliseconds(worker.limit))
+        continue;
+      
+      TestResult result { };
+      result.success = false;
+      result.timedOut = true;
+      result.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        now - worker.start).count();
+      result.failures.push_back(Failure {
+        std::string("Test timed out after ")
+          .append(std::to_string(worker.limit))
+          .append(" ms.")
+      });
+      dropCoordinatedWorker(worker, pending, collector, result, finished);
+    }
+  }
+  
+  // Let the workers teardown and exit
+  std::string done = { };
+  writeInteger(done, 0);
+  for (CoordinatedWorker &worker : workers)
+    if (worker.socket >= 0) {
+      sendMessage(worker.socket, done);
+      close(worker.socket);
+    }
+  close(server);
+  if (strncmp(address, "tcp:", 4) != 0)
+    unlink(address);
+  signal(SIGPIPE, lastPipeHandler);
+  
+  return collector.report();
+#else
+  fprintf(stderr, "Unable to coordinate tests on '%s': "
+    "sockets are not supported on this platform.\n", address);
+  return runTests(environment, schedule, 1, state);
+#endif
+}
+
+int NAMESPACE_EXPECT runCoordinatedWorker(const char *address) {
+#if _EXPECT_COORDINATE
+  int coordinator = coordinatorSocket(address, false);
+  if (coordinator < 0)
+    return 1;
+  
+  // Run in the same environment as the coordinator
+  Environment environment { };
+  std::string message;
+  const char *data, *end;
+  uint64_t stopOnFailure, timeout, minIterations, maxIterations, minTime,
+    maxTime, counters;
+  if (!receiveMessage(coordinator, message) ||
+      (data = message.data(), end = data + message.size(),
+        !readInteger(data, end, stopOnFailure) ||
+        !readInteger(data, end, timeout) ||
+        !readDouble(data, end, environment.benchmarking.precision) ||
+        !readInteger(data, end, minIterations) ||
+        !readInteger(data, end, maxIterations) ||
+        !readInteger(data, end, minTime) ||
+        !readInteger(data, end, maxTime) ||
+        !readInteger(data, end, counters))) {
+    fprintf(stderr, "Unable to join the coordinator at '%s'.\n", address);
+    close(coordinator);
+    return 1;
+  }
+  environment.stopOnFailure = stopOnFailure != 0;
+  environment.timeout = (long long)timeout;
+  environment.benchmarking.minIterations = (size_t)minIterations;
+  environment.benchmarking.maxIterations = (size_t)maxIterations;
+  environment.benchmarking.minTime = (long long)minTime;
+  environment.benchmarking.maxTime = (long long)maxTime;
+  environment.benchmarking.counters = counters != 0;
+  
+  // Test cases are handed out by name, since the coordinator may be a
+  // different build
+  std::unordered_map<std::string, std::pair<Suite *, Test *>> tests = { };
+  for (Suite *suite : suites())
+    for (Test &test : suite->tests)
+      tests.insert(std::make_pair(
+        std::string(suite->name).append("\t").append(test.name),
+        std::make_pair(suite, &test)));
+  
+  signal(SIGPIPE, SIG_IGN);
+  std::vector<Suite *> ready = { };
+  bool running = true;
+  while (running && receiveMessage(coordinator, message)) {
+    data = message.data();
+    end = data + message.size();
+    uint64_t count;
+    if (!readInteger(data, end, count) || count == 0)
+      break;
+    
+    for (uint64_t i = 0; running && i < count; i++) {
+      uint64_t index;
+      std::string suiteName, testName;
+      if (!readInteger(data, end, index) ||
+          !readString(data, end, suiteName) ||
+          !readString(data, end, testName)) {
+        running = false;
+        break;
+      }
+      
+      TestResult result { };
+      auto found = tests.find(suiteName.append("\t").append(testName));
+      if (found == tests.end()) {
+        result.success = false;
+        result.failures.push_back(Failure {
+          "Test not found in the worker process."
+        });
+      } else {
+        // Setup the suite the first time this worker runs one of its tests
+        Suite *suite = found->second.first;
+        if (std::find(ready.begin(), ready.end(), suite) == ready.end()) {
+          suite->runSetup();
+          ready.push_back(suite);
+        }
+        result = runTest(environment, *found->second.second);
+      }
+      fflush(stdout);
+      fflush(stderr);
+      
+      std::string reply = { };
+      writeInteger(reply, index);
+      writeResult(reply, result);
+      running = sendMessage(coordinator, reply);
+    }
+  }
+  
+  // Teardown all of the suites that were set up
+  for (auto suite = ready.rbegin(); suite != ready.rend(); suite++)
+    (*suite)->runTeardown();
+  close(coordinator);
+  return 0;
+#else
+  fprintf(stderr, "Unable to connect to '%s': "
+    "sockets are not supported on this platform.\n", address);
+  return 1;
+#endif
+}
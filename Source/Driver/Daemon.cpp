@@ -0,0 +1,240 @@
+// ===--- Daemon.cpp --------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of serving test runs to clients over a Unix socket.         //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Driver/Daemon.h>
+#include <Driver/Transport.h>
+#include <Driver/CommandLineDriver.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#define _EXPECT_DAEMON 1
+#endif
+
+#if _EXPECT_DAEMON
+
+/// Fill in the address of a Unix socket.
+static bool daemonAddress(const char *path, sockaddr_un &address) {
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Socket path '%s' is too long.\n", path);
+    return false;
+  }
+  strcpy(address.sun_path, path);
+  return true;
+}
+
+#endif
+
+
+
+void NAMESPACE_EXPECT sendDaemonOutput(
+  int                socket,
+  const std::string &text
+) {
+  std::string message = { };
+  writeInteger(message, (uint64_t)DaemonMessage::Output);
+  writeString(message, text);
+  sendMessage(socket, message);
+}
+
+void NAMESPACE_EXPECT sendDaemonEvent(
+  int       socket,
+  RunState &state ,
+  Suite    &suite
+) {
+  std::string message = { };
+  writeInteger(message, (uint64_t)DaemonMessage::Event);
+  writeInteger(message, (uint64_t)state.state);
+  writeString(message, suite.name);
+  switch (state.state) {
+  case RunState::State::RunningSuite:
+    break;
+  
+  case RunState::State::FinishedSuite: {
+    FinishedSuite &finished = (FinishedSuite &)state;
+    writeInteger(message, finished.successful);
+    writeInteger(message, finished.count);
+  } break;
+  
+  case RunState::State::RunningTest: {
+    RunningTest &running = (RunningTest &)state;
+    writeString(message, running.test.name);
+    writeInteger(message, running.index);
+    writeInteger(message, running.count);
+  } break;
+  
+  case RunState::State::TestSuccess: {
+    TestSuccess &success = (TestSuccess &)state;
+    TestResult result { };
+    result.benchmarks = success.benchmarks;
+    result.time = success.time;
+    writeString(message, success.test.name);
+    writeResult(message, result);
+  } break;
+  
+  case RunState::State::TestFailed: {
+    TestFailed &failed = (TestFailed &)state;
+    TestResult result { };
+    result.success = false;
+    result.failures = failed.failures;
+    result.time = failed.time;
+    writeString(message, failed.test.name);
+    writeResult(message, result);
+  } break;
+  }
+  sendMessage(socket, message);
+}
+
+int NAMESPACE_EXPECT serveCommandLineTests(
+  const char *path      ,
+  const char *executable
+) {
+#if _EXPECT_DAEMON
+  sockaddr_un address;
+  if (!daemonAddress(path, address))
+    return 1;
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server < 0) {
+    fprintf(stderr, "Unable to create a socket: %s\n", strerror(errno));
+    return 1;
+  }
+  if (!clearSocketPath(path)) {
+    close(server);
+    return 1;
+  }
+  if (bind(server, (sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(server, 16) != 0) {
+    fprintf(stderr, "Unable to listen on '%s': %s\n", path, strerror(errno));
+    close(server);
+    return 1;
+  }
+  
+  // A client that goes away mid-run must not take the daemon with it
+  signal(SIGPIPE, SIG_IGN);
+  printf("Serving tests on '%s'.\n", path);
+  fflush(stdout);
+  
+  for (;;) {
+    int client = accept(server, nullptr, nullptr);
+    if (client < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      fprintf(stderr, "Unable to accept a client: %s\n", strerror(errno));
+      close(server);
+      return 1;
+    }
+    
+    // Read the command line arguments of the run
+    std::string message;
+    std::vector<std::string> arguments = { executable };
+    bool valid = receiveMessage(client, message);
+    const char *data = message.data(), *end = data + message.size();
+    uint64_t count = 0;
+    valid = valid && readInteger(data, end, count);
+    for (uint64_t i = 0; valid && i < count; i++) {
+      std::string argument;
+      valid = readString(data, end, argument);
+      arguments.push_back(argument);
+    }
+    if (!valid) {
+      close(client);
+      continue;
+    }
+    std::vector<char *> argv = { };
+    for (std::string &argument : arguments)
+      argv.push_back(&argument[0]);
+    argv.push_back(nullptr);
+    
+    // Start from a clean selection, as a fresh process would
+    for (Suite *suite : suites())
+      for (Test &test : suite->tests)
+        test.enabled = false;
+    
+    int status =
+      runCommandLineTests((int)arguments.size(), argv.data(), client);
+    fflush(stdout);
+    fflush(stderr);
+    
+    std::string reply = { };
+    writeInteger(reply, (uint64_t)DaemonMessage::Finished);
+    writeInteger(reply, (uint64_t)status);
+    sendMessage(client, reply);
+    close(client);
+  }
+#else
+  (void)executable;
+  fprintf(stderr, "Unable to serve tests on '%s': "
+    "Unix sockets are not supported on this platform.\n", path);
+  return 1;
+#endif
+}
+
+int NAMESPACE_EXPECT runTestClient(
+  int   argc  ,
+  char *argv[]
+) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s socket [flags...] [test-names-or-suites...]\n",
+      argv[0]);
+    return 1;
+  }
+#if _EXPECT_DAEMON
+  sockaddr_un address;
+  if (!daemonAddress(argv[1], address))
+    return 1;
+  int client = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (client < 0 ||
+      connect(client, (sockaddr *)&address, sizeof(address)) != 0) {
+    fprintf(stderr, "Unable to connect to '%s': %s\n", argv[1],
+      strerror(errno));
+    if (client >= 0)
+      close(client);
+    return 1;
+  }
+  
+  std::string request = { };
+  writeInteger(request, (uint64_t)(argc - 2));
+  for (int i = 2; i < argc; i++)
+    writeString(request, argv[i]);
+  sendMessage(client, request);
+  
+  // Print the output of the run as it arrives
+  std::string message;
+  while (receiveMessage(client, message)) {
+    const char *data = message.data(), *end = data + message.size();
+    uint64_t kind, status;
+    std::string text;
+    if (!readInteger(data, end, kind))
+      break;
+    if (kind == (uint64_t)DaemonMessage::Output &&
+        readString(data, end, text)) {
+      fwrite(text.data(), 1, text.size(), stdout);
+      fflush(stdout);
+    } else if (kind == (uint64_t)DaemonMessage::Finished &&
+               readInteger(data, end, status)) {
+      close(client);
+      return (int)status;
+    }
+  }
+  close(client);
+  fprintf(stderr, "The test daemon ended the run unexpectedly.\n");
+  return 1;
+#else
+  fprintf(stderr, "Unable to connect to '%s': "
+    "Unix sockets are not supported on this platform.\n", argv[1]);
+  return 1;
+#endif
+}
@@ -12,7 +12,138 @@
 #include <Suite/Suite.h>
 #include <Suite/Setup.h>
 #include <Evaluate/Evaluate.h>
+#include <Driver/WorkQueue.h>
+#include <Driver/Watchdog.h>
+#include <Driver/EventLoop.h>
 #include <stddef.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+/// The progress of a test suite run on a pool of worker threads.
+struct SuiteProgress {
+  /// Guards the progress.
+  std::mutex lock;
+  /// Whether or not the test suite has been set up.
+  bool ready = false;
+  /// The number of test cases in the test suite that have yet to finish.
+  size_t remaining = 0;
+};
+
+/// The state of a worker thread in a pool.
+struct PoolWorker {
+  /// Incremented whenever the worker thread is abandoned and replaced.
+  size_t generation = 0;
+  /// Whether or not the worker thread is running a test case.
+  bool busy = false;
+  /// The index of the test case that the worker thread is running.
+  size_t test = 0;
+  /// The time limit of the test case, in milliseconds, or `0` for no limit.
+  long long limit = 0;
+  /// When the test case runs out of time.
+  std::chrono::steady_clock::time_point deadline;
+  /// The identifier of the worker thread.
+  long long thread = 0;
+};
+
+/// The state shared by a pool of worker threads.
+/// \remarks
+///   Owned jointly by the driver and the worker threads, so that a worker
+///   thread stuck in a test case can be abandoned safely.
+struct ThreadPool {
+  /// The test environment copied by each worker thread.
+  NAMESPACE_EXPECT Environment environment;
+  /// The test cases to run.
+  std::vector<NAMESPACE_EXPECT ScheduledTest> schedule;
+  /// The progress of each test suite, indexed by the first scheduled test
+  /// case of the suite.
+  std::vector<std::unique_ptr<SuiteProgress>> progress;
+  /// The index of the first scheduled test case of the suite of each
+  /// scheduled test case.
+  std::vector<size_t> first;
+  /// The test cases waiting to be run by each worker thread.
+  NAMESPACE_EXPECT WorkQueue queue;
+  /// Guards the worker states and the finished test cases.
+  std::mutex lock;
+  /// Signalled when a test case finishes.
+  std::condition_variable finished;
+  /// Finished test cases waiting to be reported.
+  std::deque<std::pair<size_t, NAMESPACE_EXPECT TestResult>> results;
+  /// The state of each worker thread.
+  std::vector<PoolWorker> workers;
+  
+  ThreadPool(
+    NAMESPACE_EXPECT Environment                &environment,
+    std::vector<NAMESPACE_EXPECT ScheduledTest> &schedule   ,
+    size_t                                       jobs
+  ) : environment(environment), schedule(schedule),
+      progress(schedule.size()), first(schedule.size(), 0), queue(jobs),
+      workers(jobs) { }
+};
+
+/// Run the test cases queued for a worker thread until there are none left,
+/// or until the worker thread is abandoned.
+static void runPoolWorker(
+  std::shared_ptr<ThreadPool> pool      ,
+  size_t                      worker    ,
+  size_t                      generation
+) {
+  NAMESPACE_EXPECT Environment environment = pool->environment;
+  size_t i;
+  while (pool->queue.pop(worker, i)) {
+    NAMESPACE_EXPECT Suite &suite = *pool->schedule[i].suite;
+    NAMESPACE_EXPECT Test &test = *pool->schedule[i].test;
+    SuiteProgress &progress = *pool->progress[pool->first[i]];
+    
+    // Setup the suite once, before any of its tests run
+    {
+      std::lock_guard<std::mutex> guard(progress.lock);
+      if (!progress.ready) {
+        suite.runSetup();
+        progress.ready = true;
+      }
+    }
+    
+    {
+      std::lock_guard<std::mutex> guard(pool->lock);
+      PoolWorker &state = pool->workers[worker];
+      state.busy = true;
+      state.test = i;
+      state.limit = test.timeLimit(environment.timeout);
+      state.deadline = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(state.limit);
+      state.thread = NAMESPACE_EXPECT currentThread();
+    }
+    
+    NAMESPACE_EXPECT TestResult result =
+      NAMESPACE_EXPECT runTest(environment, test);
+    
+    {
+      // The test case has already been reported as timed out, and its suite
+      // may still be in use by it, so leave it alone
+      std::lock_guard<std::mutex> guard(pool->lock);
+      if (pool->workers[worker].generation != generation)
+        return;
+      pool->workers[worker].busy = false;
+    }
+    
+    // Teardown the suite once all of its tests have run
+    bool last;
+    {
+      std::lock_guard<std::mutex> guard(progress.lock);
+      last = --progress.remaining == 0;
+    }
+    if (last)
+      suite.runTeardown();
+    
+    std::lock_guard<std::mutex> guard(pool->lock);
+    pool->results.push_back(std::make_pair(i, std::move(result)));
+    pool->finished.notify_one();
+  }
+}
 
 NAMESPACE_EXPECT Report::Report(
   size_t successful,
@@ -25,84 +156,299 @@ NAMESPACE_EXPECT Report::Report(
 
 
 NAMESPACE_EXPECT RunTests::RunTests(
-  Environment &environment
-) : environment(environment) {
+  Environment &environment,
+  size_t       jobs
+) : environment(environment), jobs(jobs) {
   
 }
 
 NAMESPACE_EXPECT Report NAMESPACE_EXPECT RunTests::operator << (
   std::function<void(RunState &)> state
 ) {
-  return runTests(environment, state);
+  return runTests(environment, jobs, state);
+}
+
+NAMESPACE_EXPECT TestResult NAMESPACE_EXPECT runTest(
+  Environment &environment,
+  Test        &test
+) {
+  if (test.async != nullptr) {
+    std::vector<Test *> tests = { &test };
+    return std::move(runAsyncTests(environment, tests)[0]);
+  }
+  
+  auto start = std::chrono::steady_clock::now();
+  try {
+    test.test(environment);
+  } catch (TestFailedException) { }
+  auto end = std::chrono::steady_clock::now();
+  
+  TestResult result { };
+  result.time =
+    std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  result.success = environment.success;
+  result.failures = std::move(environment.failures);
+  result.benchmarks = std::move(environment.benchmarks);
+  
+  environment.success = true;
+  environment.failures.clear();
+  environment.benchmarks.clear();
+  return result;
+}
+
+std::vector<NAMESPACE_EXPECT TestResult> NAMESPACE_EXPECT runAsyncTests(
+  Environment         &environment,
+  std::vector<Test *> &tests
+) {
+  /// The progress of an asynchronous test case.
+  struct AsyncRun {
+    /// The test environment that the test case runs in.
+    Environment environment;
+    /// Abandons the test case.
+    std::function<void()> abandon;
+    /// When the test case started.
+    std::chrono::steady_clock::time_point start;
+    /// Whether or not the test case has finished.
+    bool finished;
+  };
+  
+  EventLoop loop;
+  EventLoop *last = EventLoop::current();
+  EventLoop::current() = &loop;
+  
+  std::vector<TestResult> results(tests.size());
+  std::vector<std::unique_ptr<AsyncRun>> runs = { };
+  auto finish = [&](size_t i, std::exception_ptr error, bool timedOut) {
+    AsyncRun &run = *runs[i];
+    if (run.finished)
+      return;
+    run.finished = true;
+    loop.cancel(i + 1);
+    
+    TestResult &result = results[i];
+    result.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - run.start).count();
+    result.success = run.environment.success;
+    result.failures = std::move(run.environment.failures);
+    result.benchmarks = std::move(run.environment.benchmarks);
+    result.timedOut = timedOut;
+    try {
+      if (error)
+        std::rethrow_exception(error);
+    } catch (TestFailedException) {
+    } catch (std::exception &exception) {
+      result.success = false;
+      result.failures.push_back(Failure {
+        std::string("Test threw an exception: ").append(exception.what())
+      });
+    } catch (...) {
+      result.success = false;
+      result.failures.push_back(Failure { "Test threw an exception." });
+    }
+  };
+  
+  // Start every test case, each registering its waits under its own owner
+  for (size_t i = 0; i < tests.size(); i++) {
+    Test &test = *tests[i];
+    runs.push_back(std::unique_ptr<AsyncRun>(new AsyncRun {
+      environment, nullptr, std::chrono::steady_clock::now(), false
+    }));
+    loop.owner = i + 1;
+    
+    long long limit = test.timeLimit(environment.timeout);
+    if (limit > 0)
+      loop.waitFor(limit * 1000000, [&, i, limit]() -> void {
+        finish(i, nullptr, true);
+        runs[i]->abandon();
+        results[i].success = false;
+        results[i].time = limit * 1000000;
+        results[i].failures.push_back(Failure {
+          std::string("Test timed out after ")
+            .append(std::to_string(limit))
+            .append(" ms.")
+        });
+      });
+    
+    std::function<void()> abandon = test.async(runs[i]->environment,
+      [&, i](std::exception_ptr error) -> void { finish(i, error, false); });
+    runs[i]->abandon = std::move(abandon);
+  }
+  loop.owner = 0;
+  loop.run();
+  
+  // Whatever is still running is waiting on something that will never happen
+  for (size_t i = 0; i < tests.size(); i++)
+    if (!runs[i]->finished) {
+      finish(i, nullptr, false);
+      runs[i]->abandon();
+      results[i].success = false;
+      results[i].failures.push_back(Failure {
+        "Test never finished, since it was left waiting on nothing."
+      });
+    }
+  
+  EventLoop::current() = last;
+  return results;
+}
+
+NAMESPACE_EXPECT Report NAMESPACE_EXPECT runTests(
+  Environment                    &environment,
+  std::function<void(RunState &)> state
+) {
+  return runTests(environment, 1, state);
 }
 
 NAMESPACE_EXPECT Report NAMESPACE_EXPECT runTests(
   Environment                    &environment,
+  size_t                          jobs       ,
   std::function<void(RunState &)> state
 ) {
-  // Run all of the tests
-  size_t totalCount = 0, totalSuccessful = 0;
-  for (Suite *suite : suites()) {
-    // Check that at least one test needs to be run
-    size_t count = 0;
-    for (Test &test : suite->tests)
-      if (test.enabled)
-        count++;
-    
-    if (count > 0) {
-      // Report
-      if (state != nullptr) {
-        RunningSuite _state(*suite);
-        state(_state);
-      }
+  std::vector<ScheduledTest> schedule = enabledTests();
+  return runTests(environment, schedule, jobs, state);
+}
+
+NAMESPACE_EXPECT Report NAMESPACE_EXPECT runTests(
+  Environment                    &environment,
+  std::vector<ScheduledTest>     &schedule   ,
+  size_t                          jobs       ,
+  std::function<void(RunState &)> state
+) {
+  Collector collector { schedule, state };
+  if (jobs == 0)
+    jobs = std::max(std::thread::hardware_concurrency(), 1u);
+  jobs = std::max<size_t>(std::min(jobs, schedule.size()), 1);
+  
+  // Test cases with a time limit have to be watched from another thread, but
+  // asynchronous test cases are timed by their event loop instead
+  bool limited = false;
+  for (ScheduledTest &scheduled : schedule)
+    if (scheduled.test->async == nullptr &&
+        scheduled.test->timeLimit(environment.timeout) > 0)
+      limited = true;
+  
+  if (jobs <= 1 && !limited) {
+    // Run all of the tests on the calling thread
+    for (size_t i = 0; i < schedule.size(); ) {
+      Suite &suite = *schedule[i].suite;
+      collector.start(i);
       
       // Setup the suite
-      if (suite->setup != nullptr)
-        suite->setup();
+      if (collector.index[i] == 1)
+        suite.runSetup();
       
-      size_t successful = 0, index = 0;
-      for (Test &test : suite->tests)
-        if (test.enabled) {
-          index++;
-          if (state != nullptr) {
-            RunningTest _state(*suite, test, index, count);
-            state(_state);
-          }
-          try {
-            test.test(environment);
-          } catch (TestFailedException) { }
-          if (environment.success) {
-            if (state != nullptr) {
-              TestSuccess _state(test, environment.benchmarks);
-              state(_state);
-            }
-            successful++;
-          } else {
-            if (state != nullptr) {
-              TestFailed _state(test, environment.failures);
-              state(_state);
-            }
-          }
-          environment.success = true;
-          environment.failures.clear();
-          environment.benchmarks.clear();
-        }
-      totalCount += count;
-      totalSuccessful += successful;
+      // Consecutive asynchronous tests of the suite run interleaved
+      size_t end = i + 1;
+      std::vector<TestResult> results = { };
+      if (schedule[i].test->async != nullptr) {
+        std::vector<Test *> tests = { schedule[i].test };
+        while (end < schedule.size() && schedule[end].suite == &suite &&
+               schedule[end].test->async != nullptr)
+          tests.push_back(schedule[end++].test);
+        results = runAsyncTests(environment, tests);
+      } else {
+        results.push_back(runTest(environment, *schedule[i].test));
+      }
       
       // Teardown the suite
-      if (suite->teardown != nullptr) {
-        suite->teardown();
-        suite->cleanup();
-      }
+      if (collector.index[end - 1] == collector.count[end - 1])
+        suite.runTeardown();
       
-      // Report
-      if (state != nullptr) {
-        FinishedSuite _state(*suite, successful, count);
-        state(_state);
+      for (TestResult &result : results)
+        collector.finish(i++, std::move(result));
+    }
+    return collector.report();
+  }
+  
+  std::shared_ptr<ThreadPool> pool =
+    std::make_shared<ThreadPool>(environment, schedule, jobs);
+  for (size_t i = 0; i < schedule.size(); i++) {
+    pool->first[i] = i - (collector.index[i] - 1);
+    if (collector.index[i] == 1) {
+      pool->progress[i] = std::unique_ptr<SuiteProgress>(new SuiteProgress());
+      pool->progress[i]->remaining = collector.count[i];
+    }
+  }
+  
+  // Deal the tests out to the workers, longest first, always to the worker
+  // with the least expected work
+  std::vector<long long> load(jobs, 0);
+  long long estimate = expectedTime(schedule);
+  for (size_t i : dispatchOrder(schedule)) {
+    size_t worker = std::min_element(load.begin(), load.end()) - load.begin();
+    load[worker] += schedule[i].time >= 0 ? schedule[i].time : estimate;
+    pool->queue.push(worker, i);
+  }
+  pool->queue.stealing = !environment.pinned;
+  
+  std::vector<std::thread> threads;
+  for (size_t worker = 0; worker < jobs; worker++)
+    threads.push_back(std::thread(runPoolWorker, pool, worker, 0));
+  
+  // Report the results from the calling thread, which also watches for test
+  // cases that exceed their time limit
+  size_t reported = 0;
+  while (reported < schedule.size()) {
+    std::unique_lock<std::mutex> guard(pool->lock);
+    if (pool->results.empty()) {
+      auto deadline = std::chrono::steady_clock::time_point::max();
+      for (PoolWorker &worker : pool->workers)
+        if (worker.busy && worker.limit > 0)
+          deadline = std::min(deadline, worker.deadline);
+      if (deadline == std::chrono::steady_clock::time_point::max())
+        pool->finished.wait(guard);
+      else
+        pool->finished.wait_until(guard, deadline);
+    }
+    
+    // Abandon the workers whose test case ran out of time
+    std::vector<size_t> expired = { };
+    auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < jobs; i++) {
+      PoolWorker &worker = pool->workers[i];
+      if (worker.busy && worker.limit > 0 && worker.deadline <= now) {
+        worker.busy = false;
+        worker.generation++;
+        expired.push_back(i);
       }
     }
+    std::vector<PoolWorker> stuck = { };
+    for (size_t i : expired)
+      stuck.push_back(pool->workers[i]);
+    std::deque<std::pair<size_t, TestResult>> results =
+      std::move(pool->results);
+    pool->results.clear();
+    guard.unlock();
+    
+    for (size_t i = 0; i < expired.size(); i++) {
+      PoolWorker &worker = stuck[i];
+      TestResult result { };
+      result.success = false;
+      result.timedOut = true;
+      result.time = worker.limit * 1000000;
+      result.failures.push_back(Failure {
+        std::string("Test timed out after ")
+          .append(std::to_string(worker.limit))
+          .append(" ms.")
+      });
+      for (Failure &stack : captureStacks(worker.thread))
+        result.failures.push_back(std::move(stack));
+      
+      // The stuck thread can't be stopped, so leave it behind and carry on
+      // with a fresh one
+      threads[expired[i]].detach();
+      threads[expired[i]] = std::thread(
+        runPoolWorker, pool, expired[i], worker.generation);
+      
+      collector.finish(worker.test, std::move(result));
+      reported++;
+    }
+    for (std::pair<size_t, TestResult> &result : results) {
+      collector.finish(result.first, std::move(result.second));
+      reported++;
+    }
   }
   
-  return Report(totalSuccessful, totalCount);
+  for (std::thread &thread : threads)
+    thread.join();
+  return collector.report();
 }
@@ -0,0 +1,262 @@
+// ===--- EventLoop.cpp ------------------------------------------ C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of the event loop that asynchronous test cases run on.      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Driver/EventLoop.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+#define _EXPECT_EPOLL 1
+#elif defined(__unix__) || defined(__APPLE__)
+#include <poll.h>
+#include <errno.h>
+#define _EXPECT_POLL 1
+#endif
+
+/// The events that a file is waited on for reading.
+#define _EXPECT_READ 1
+/// The events that a file is waited on for writing.
+#define _EXPECT_WRITE 2
+
+NAMESPACE_EXPECT EventLoop::EventLoop() {
+  #if _EXPECT_EPOLL
+  poller = epoll_create1(EPOLL_CLOEXEC);
+  timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  epoll_event event { };
+  event.events = EPOLLIN;
+  event.data.fd = timer;
+  epoll_ctl(poller, EPOLL_CTL_ADD, timer, &event);
+  #endif
+}
+
+NAMESPACE_EXPECT EventLoop::~EventLoop() {
+  #if _EXPECT_EPOLL
+  close(timer);
+  close(poller);
+  #endif
+}
+
+void NAMESPACE_EXPECT EventLoop::waitReadable(
+  int                   file    ,
+  std::function<void()> callback
+) {
+  files[file].read.push_back(Wait { owner, std::move(callback) });
+  update(file);
+}
+
+void NAMESPACE_EXPECT EventLoop::waitWritable(
+  int                   file    ,
+  std::function<void()> callback
+) {
+  files[file].write.push_back(Wait { owner, std::move(callback) });
+  update(file);
+}
+
+void NAMESPACE_EXPECT EventLoop::waitFor(
+  long long             nanoseconds,
+  std::function<void()> callback
+) {
+  timers.insert(std::make_pair(
+    std::chrono::steady_clock::now() +
+      std::chrono::nanoseconds(std::max(nanoseconds, 0ll)),
+    Wait { owner, std::move(callback) }));
+}
+
+void NAMESPACE_EXPECT EventLoop::cancel(size_t owner) {
+  auto owned = [=](const Wait &wait) -> bool { return wait.owner == owner; };
+  
+  std::vector<int> changed = { };
+  for (auto &entry : files) {
+    FileWaits &waits = entry.second;
+    size_t count = waits.read.size() + waits.write.size();
+    waits.read.erase(std::remove_if(
+      waits.read.begin(), waits.read.end(), owned), waits.read.end());
+    waits.write.erase(std::remove_if(
+      waits.write.begin(), waits.write.end(), owned), waits.write.end());
+    if (waits.read.size() + waits.write.size() != count)
+      changed.push_back(entry.first);
+  }
+  for (int file : changed)
+    update(file);
+  
+  for (auto timer = timers.begin(); timer != timers.end(); )
+    if (timer->second.owner == owner)
+      timer = timers.erase(timer);
+    else
+      timer++;
+  
+  ready.erase(std::remove_if(ready.begin(), ready.end(), owned), ready.end());
+}
+
+void NAMESPACE_EXPECT EventLoop::update(int file) {
+  auto entry = files.find(file);
+  if (entry == files.end())
+    return;
+  FileWaits &waits = entry->second;
+  int events = (waits.read.empty() ? 0 : _EXPECT_READ) |
+    (waits.write.empty() ? 0 : _EXPECT_WRITE);
+  
+  #if _EXPECT_EPOLL
+  if (events != waits.events) {
+    epoll_event event { };
+    event.events = ((events & _EXPECT_READ) ? (uint32_t)EPOLLIN : 0) |
+      ((events & _EXPECT_WRITE) ? (uint32_t)EPOLLOUT : 0);
+    event.data.fd = file;
+    int operation = events == 0 ? EPOLL_CTL_DEL :
+      waits.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (epoll_ctl(poller, operation, file, &event) != 0 && events != 0) {
+      // Files that can't be polled, such as regular files, are always ready
+      for (Wait &wait : waits.read)
+        ready.push_back(std::move(wait));
+      for (Wait &wait : waits.write)
+        ready.push_back(std::move(wait));
+      files.erase(entry);
+      return;
+    }
+  }
+  #endif
+  
+  if (events == 0)
+    files.erase(entry);
+  else
+    waits.events = events;
+}
+
+void NAMESPACE_EXPECT EventLoop::dispatch() {
+  // Timers that have expired
+  auto now = std::chrono::steady_clock::now();
+  while (!timers.empty() && timers.begin()->first <= now) {
+    ready.push_back(std::move(timers.begin()->second));
+    timers.erase(timers.begin());
+  }
+  
+  size_t last = owner;
+  while (!ready.empty()) {
+    Wait wait = std::move(ready.front());
+    ready.pop_front();
+    owner = wait.owner;
+    wait.callback();
+  }
+  owner = last;
+}
+
+bool NAMESPACE_EXPECT EventLoop::step() {
+  if (!ready.empty()) {
+    dispatch();
+    return true;
+  }
+  if (files.empty() && timers.empty())
+    return false;
+  
+  // Wait until the nearest timer expires
+  long long timeout = -1;
+  if (!timers.empty())
+    timeout = std::max(1ll, (long long)
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        timers.begin()->first - std::chrono::steady_clock::now()).count());
+  
+  #if _EXPECT_EPOLL
+  itimerspec expiry { };
+  if (timeout > 0) {
+    expiry.it_value.tv_sec = (time_t)(timeout / 1000000000);
+    expiry.it_value.tv_nsec = (long)(timeout % 1000000000);
+  }
+  timerfd_settime(timer, 0, &expiry, nullptr);
+  
+  epoll_event events[64];
+  int count = epoll_wait(poller, events, 64, -1);
+  if (count < 0 && errno != EINTR)
+    count = 0;
+  for (int i = 0; i < count; i++) {
+    int file = events[i].data.fd;
+    if (file == timer) {
+      uint64_t expirations;
+      ssize_t size = read(timer, &expirations, sizeof(expirations));
+      (void)size;
+      continue;
+    }
+    auto entry = files.find(file);
+    if (entry == files.end())
+      continue;
+    
+    bool failed = (events[i].events & (EPOLLERR | EPOLLHUP)) != 0;
+    FileWaits &waits = entry->second;
+    if (failed || (events[i].events & EPOLLIN) != 0) {
+      for (Wait &wait : waits.read)
+        ready.push_back(std::move(wait));
+      waits.read.clear();
+    }
+    if (failed || (events[i].events & EPOLLOUT) != 0) {
+      for (Wait &wait : waits.write)
+        ready.push_back(std::move(wait));
+      waits.write.clear();
+    }
+    update(file);
+  }
+  #elif _EXPECT_POLL
+  std::vector<pollfd> polled = { };
+  for (auto &entry : files)
+    polled.push_back(pollfd { entry.first, (short)(
+      ((entry.second.events & _EXPECT_READ) ? POLLIN : 0) |
+      ((entry.second.events & _EXPECT_WRITE) ? POLLOUT : 0)), 0 });
+  int milliseconds = timeout < 0 ? -1 :
+    (int)std::min((timeout + 999999) / 1000000, 1ll << 30);
+  if (poll(polled.data(), polled.size(), milliseconds) > 0)
+    for (pollfd &file : polled) {
+      auto entry = files.find(file.fd);
+      if (file.revents == 0 || entry == files.end())
+        continue;
+      
+      bool failed = (file.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+      FileWaits &waits = entry->second;
+      if (failed || (file.revents & POLLIN) != 0) {
+        for (Wait &wait : waits.read)
+          ready.push_back(std::move(wait));
+        waits.read.clear();
+      }
+      if (failed || (file.revents & POLLOUT) != 0) {
+        for (Wait &wait : waits.write)
+          ready.push_back(std::move(wait));
+        waits.write.clear();
+      }
+      update(file.fd);
+    }
+  #else
+  // Files can't be waited on, so they are always ready
+  for (auto &entry : files) {
+    for (Wait &wait : entry.second.read)
+      ready.push_back(std::move(wait));
+    for (Wait &wait : entry.second.write)
+      ready.push_back(std::move(wait));
+  }
+  files.clear();
+  if (ready.empty() && timeout > 0)
+    std::this_thread::sleep_for(std::chrono::nanoseconds(timeout));
+  #endif
+  
+  dispatch();
+  return true;
+}
+
+void NAMESPACE_EXPECT EventLoop::run() {
+  EventLoop *last = current();
+  current() = this;
+  while (step()) { }
+  current() = last;
+}
+
+NAMESPACE_EXPECT EventLoop *&NAMESPACE_EXPECT EventLoop::current() {
+  static thread_local EventLoop *loop = nullptr;
+  return loop;
+}
@@ -0,0 +1,134 @@
+// ===--- History.cpp -------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of recording how test cases went in previous runs.         //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Driver/History.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+/// Get the key of a test case in a test history.
+static std::string historyKey(
+  NAMESPACE_EXPECT Suite &suite,
+  NAMESPACE_EXPECT Test  &test
+) {
+  return std::string(suite.name).append("\t").append(test.name);
+}
+
+bool NAMESPACE_EXPECT History::load(const char *path) {
+  FILE *handle = fopen(path, "r");
+  if (handle == NULL)
+    return false;
+  
+  std::string line = "";
+  for (int c = fgetc(handle); c != EOF; c = fgetc(handle)) {
+    if (c != '\n') {
+      line.push_back((char)c);
+      continue;
+    }
+    
+    // `[!] time \t suite \t test`
+    bool failed = !line.empty() && line[0] == '!';
+    const char *start = line.c_str() + (failed ? 1 : 0);
+    char *end;
+    long long time = strtoll(start, &end, 10);
+    if (*end == '\t' && end != start && time >= 0) {
+      times[end + 1] = time;
+      if (failed)
+        failures.insert(end + 1);
+    }
+    line.clear();
+  }
+  
+  fclose(handle);
+  return true;
+}
+
+bool NAMESPACE_EXPECT History::save(const char *path) {
+  // Write to a temporary file first so that an interrupted run never leaves a
+  // truncated history behind
+  std::string temporary = std::string(path).append(".tmp");
+  FILE *handle = fopen(temporary.c_str(), "w");
+  if (handle == NULL)
+    return false;
+  
+  for (auto &entry : times)
+    fprintf(handle, "%s%lld\t%s\n", failures.count(entry.first) ? "!" : "",
+      entry.second, entry.first.c_str());
+  
+  if (fclose(handle) != 0) {
+    remove(temporary.c_str());
+    return false;
+  }
+  return rename(temporary.c_str(), path) == 0;
+}
+
+long long NAMESPACE_EXPECT History::time(
+  Suite &suite,
+  Test  &test
+) {
+  auto entry = times.find(historyKey(suite, test));
+  return entry == times.end() ? -1 : entry->second;
+}
+
+bool NAMESPACE_EXPECT History::failed(
+  Suite &suite,
+  Test  &test
+) {
+  return failures.count(historyKey(suite, test)) > 0;
+}
+
+void NAMESPACE_EXPECT History::record(
+  Suite    &suite ,
+  Test     &test  ,
+  long long time  ,
+  bool      failed
+) {
+  std::string key = historyKey(suite, test);
+  if (failed)
+    failures.insert(key);
+  else
+    failures.erase(key);
+  times[key] = time;
+}
+
+void NAMESPACE_EXPECT History::estimate(
+  std::vector<ScheduledTest> &schedule
+) {
+  for (ScheduledTest &scheduled : schedule)
+    scheduled.time = time(*scheduled.suite, *scheduled.test);
+}
+
+void NAMESPACE_EXPECT History::prioritize(
+  std::vector<ScheduledTest> &schedule
+) {
+  for (ScheduledTest &scheduled : schedule)
+    scheduled.first = failed(*scheduled.suite, *scheduled.test);
+  
+  // Keep the test cases of each test suite together, with the test suites
+  // that have a failed test case first and their failed test cases leading
+  std::vector<Suite *> failing = { };
+  for (ScheduledTest &scheduled : schedule)
+    if (scheduled.first &&
+        std::find(failing.begin(), failing.end(), scheduled.suite) ==
+          failing.end())
+      failing.push_back(scheduled.suite);
+  std::stable_sort(schedule.begin(), schedule.end(), [&](
+    const ScheduledTest &lhs,
+    const ScheduledTest &rhs
+  ) {
+    size_t left = std::find(failing.begin(), failing.end(), lhs.suite) -
+      failing.begin();
+    size_t right = std::find(failing.begin(), failing.end(), rhs.suite) -
+      failing.begin();
+    if (left != right)
+      return left < right;
+    return lhs.first && !rhs.first;
+  });
+}
@@ -0,0 +1,102 @@
+// ===--- Plugins.cpp -------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of loading test suites from plugins on demand.              //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Driver/Plugins.h>
+#include <Suite/Index.h>
+#include <Suite/Suite.h>
+#include <stdio.h>
+#include <algorithm>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+bool NAMESPACE_EXPECT PluginManifest::load(const char *path) {
+  FILE *handle = fopen(path, "r");
+  if (handle == NULL)
+    return false;
+  
+  // Plugins are found relative to the manifest
+  std::string directory = path;
+  size_t slash = directory.find_last_of("/\\");
+  directory = slash == std::string::npos ? "" : directory.substr(0, slash + 1);
+  
+  std::string line = "";
+  for (int c = fgetc(handle); c != EOF; c = fgetc(handle)) {
+    if (c != '\n') {
+      line.push_back((char)c);
+      continue;
+    }
+    
+    // `suite \t plugin`
+    size_t tab = line.find('\t');
+    if (tab != std::string::npos && tab > 0 && tab + 1 < line.size()) {
+      std::string plugin = line.substr(tab + 1);
+      bool absolute = plugin[0] == '/' || plugin[0] == '\\' ||
+        (plugin.size() > 1 && plugin[1] == ':');
+      if (!absolute)
+        plugin = directory + plugin;
+      if (std::find(plugins.begin(), plugins.end(), plugin) == plugins.end()) {
+        plugins.push_back(plugin);
+        loaded.push_back(false);
+      }
+      suites[line.substr(0, tab)] = plugin;
+    }
+    line.clear();
+  }
+  
+  fclose(handle);
+  return true;
+}
+
+bool NAMESPACE_EXPECT PluginManifest::loadSuite(const char *name) {
+  error.clear();
+  auto entry = suites.find(name);
+  if (entry == suites.end())
+    return false;
+  size_t plugin =
+    std::find(plugins.begin(), plugins.end(), entry->second) - plugins.begin();
+  return !loaded[plugin] && loadPlugin(plugin);
+}
+
+bool NAMESPACE_EXPECT PluginManifest::loadAll() {
+  error.clear();
+  bool success = true;
+  for (size_t plugin = 0; plugin < plugins.size(); plugin++)
+    if (!loaded[plugin] && !loadPlugin(plugin))
+      success = false;
+  return success;
+}
+
+bool NAMESPACE_EXPECT PluginManifest::loadPlugin(size_t plugin) {
+  // A plugin that fails to load isn't tried again
+  loaded[plugin] = true;
+  
+  // The test suites of the plugin register themselves as it is loaded, and
+  // the plugin is never unloaded since they stay registered
+  #if defined(_WIN32)
+  if (LoadLibraryA(plugins[plugin].c_str()) == NULL) {
+    error = std::string("Unable to load the plugin '")
+      .append(plugins[plugin]).append("'.");
+    return false;
+  }
+  #else
+  if (dlopen(plugins[plugin].c_str(), RTLD_NOW | RTLD_GLOBAL) == nullptr) {
+    const char *reason = dlerror();
+    error = reason != nullptr ? reason : std::string("Unable to load the ")
+      .append("plugin '").append(plugins[plugin]).append("'.");
+    return false;
+  }
+  #endif
+  
+  testIndex().build(::NAMESPACE_EXPECT suites());
+  return true;
+}
@@ -0,0 +1,542 @@
+// ===--- ProcessDriver.cpp -------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The test driver used when running tests in isolated worker processes.      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Driver/ProcessDriver.h>
+#include <Driver/Transport.h>
+#include <Driver/Watchdog.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <stdio.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/wait.h>
+#define _EXPECT_FORK 1
+#endif
+
+#if _EXPECT_FORK
+
+/// A forked worker process.
+struct ForkedWorker {
+  /// The process ID of the worker.
+  pid_t process = -1;
+  /// The pipe used to send test cases to the worker.
+  int input = -1;
+  /// The pipe used to receive test results from the worker.
+  int output = -1;
+  /// The pipe used to receive call stacks from the worker.
+  int diagnostics = -1;
+  /// Whether or not the worker is running a test case.
+  bool busy = false;
+  /// The index of the test case that the worker is running.
+  size_t test = 0;
+  /// When the worker was handed the test case that it is running.
+  std::chrono::steady_clock::time_point start;
+  /// The time limit of the test case, in milliseconds, or `0` for no limit.
+  long long limit = 0;
+  /// Whether or not the worker runs each test case in a child process of its
+  /// own, in the process group that the worker leads.
+  bool isolated = false;
+};
+
+/// Describe how a worker process ended.
+static std::string describeForkedExit(int status) {
+  if (WIFSIGNALED(status)) {
+    int signal = WTERMSIG(status);
+    const char *name = strsignal(signal);
+    return std::string("Test crashed with signal ")
+      .append(std::to_string(signal))
+      .append(" (")
+      .append(name != nullptr ? name : "unknown signal")
+      .append(").");
+  } else if (WIFEXITED(status)) {
+    return std::string("Test exited the process with status ")
+      .append(std::to_string(WEXITSTATUS(status)))
+      .append(".");
+  } else {
+    return "Test ended the process unexpectedly.";
+  }
+}
+
+/// Fail a test case that couldn't be isolated, without running it.
+/// \param[in] call
+///   The name of the system call that failed, which set `errno`.
+static NAMESPACE_EXPECT TestResult isolationFailure(const char *call) {
+  NAMESPACE_EXPECT TestResult result { };
+  result.success = false;
+  result.failures.push_back(NAMESPACE_EXPECT Failure {
+    std::string("Unable to isolate the test, ")
+      .append(call)
+      .append(" failed: ")
+      .append(strerror(errno))
+      .append(".")
+  });
+  return result;
+}
+
+/// Run a test case in a child process forked from a worker process, so that
+/// it starts from a fresh copy of the worker and can't leave anything behind.
+/// \param[out] overhead
+///   The time spent forking and reaping the child process, in nanoseconds.
+static NAMESPACE_EXPECT TestResult runIsolatedTest(
+  NAMESPACE_EXPECT Environment &environment,
+  NAMESPACE_EXPECT Test        &test       ,
+  long long                    &overhead
+) {
+  int results[2];
+  if (pipe(results) != 0)
+    return isolationFailure("pipe");
+  fflush(stdout);
+  fflush(stderr);
+  
+  auto start = std::chrono::steady_clock::now();
+  pid_t child = fork();
+  if (child < 0) {
+    NAMESPACE_EXPECT TestResult result = isolationFailure("fork");
+    close(results[0]);
+    close(results[1]);
+    return result;
+  } else if (child == 0) {
+    close(results[0]);
+    NAMESPACE_EXPECT TestResult result =
+      NAMESPACE_EXPECT runTest(environment, test);
+    fflush(stdout);
+    fflush(stderr);
+    std::string message = { };
+    NAMESPACE_EXPECT writeResult(message, result);
+    NAMESPACE_EXPECT sendMessage(results[1], message);
+    _exit(0);
+  }
+  close(results[1]);
+  
+  // The driver asks the whole process group for its call stacks when the test
+  // case times out, and only the call stack of the child is of any use
+  int stack = NAMESPACE_EXPECT stackSignal();
+  void (*lastStackHandler)(int) = SIG_DFL;
+  if (stack != 0)
+    lastStackHandler = signal(stack, SIG_IGN);
+  
+  std::string message;
+  bool received = NAMESPACE_EXPECT receiveMessage(results[0], message);
+  close(results[0]);
+  int status = 0;
+  while (waitpid(child, &status, 0) < 0 && errno == EINTR) { }
+  if (stack != 0)
+    signal(stack, lastStackHandler);
+  long long time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  
+  NAMESPACE_EXPECT TestResult result { };
+  const char *data = message.data();
+  if (received && NAMESPACE_EXPECT readResult(
+        data, message.data() + message.size(), result)) {
+    overhead = std::max(time - result.time, 0ll);
+  } else {
+    // The test case took the child down with it
+    result = NAMESPACE_EXPECT TestResult { };
+    result.success = false;
+    result.time = time;
+    result.failures.push_back(NAMESPACE_EXPECT Failure {
+      describeForkedExit(status)
+    });
+  }
+  return result;
+}
+
+/// Run the test cases sent by the driver process until it closes the pipe,
+/// then exit.
+static void runForkedWorker(
+  NAMESPACE_EXPECT Environment                 environment,
+  std::vector<NAMESPACE_EXPECT ScheduledTest> &schedule   ,
+  int                                          input      ,
+  int                                          output     ,
+  int                                          diagnostics,
+  bool                                         isolate
+) {
+  NAMESPACE_EXPECT installStackDump(diagnostics);
+  if (isolate)
+    setpgid(0, 0);
+  
+  std::vector<NAMESPACE_EXPECT Suite *> ready = { };
+  std::string message;
+  while (NAMESPACE_EXPECT receiveMessage(input, message)) {
+    const char *data = message.data();
+    uint64_t index;
+    if (!NAMESPACE_EXPECT readInteger(data, data + message.size(), index) ||
+        index >= schedule.size())
+      break;
+    
+    // Setup the suite the first time this worker runs one of its tests
+    NAMESPACE_EXPECT Suite *suite = schedule[index].suite;
+    if (std::find(ready.begin(), ready.end(), suite) == ready.end()) {
+      suite->runSetup();
+      ready.push_back(suite);
+    }
+    
+    long long overhead = 0;
+    NAMESPACE_EXPECT TestResult result = isolate ?
+      runIsolatedTest(environment, *schedule[index].test, overhead) :
+      NAMESPACE_EXPECT runTest(environment, *schedule[index].test);
+    fflush(stdout);
+    fflush(stderr);
+    
+    std::string reply = { };
+    NAMESPACE_EXPECT writeInteger(reply, index);
+    NAMESPACE_EXPECT writeResult(reply, result);
+    NAMESPACE_EXPECT writeInteger(reply, (uint64_t)overhead);
+    if (!NAMESPACE_EXPECT sendMessage(output, reply))
+      break;
+  }
+  
+  // Teardown all of the suites that were set up
+  for (auto suite = ready.rbegin(); suite != ready.rend(); suite++)
+    (*suite)->runTeardown();
+  fflush(stdout);
+  fflush(stderr);
+  _exit(0);
+}
+
+/// Fork a new worker process.
+static bool spawnForkedWorker(
+  ForkedWorker                                &worker     ,
+  std::vector<ForkedWorker>                   &workers    ,
+  NAMESPACE_EXPECT Environment                &environment,
+  std::vector<NAMESPACE_EXPECT ScheduledTest> &schedule
+) {
+  int input[2], output[2], diagnostics[2];
+  if (pipe(input) != 0)
+    return false;
+  if (pipe(output) != 0) {
+    close(input[0]);
+    close(input[1]);
+    return false;
+  }
+  if (pipe(diagnostics) != 0) {
+    close(input[0]);
+    close(input[1]);
+    close(output[0]);
+    close(output[1]);
+    return false;
+  }
+  
+  // Don't duplicate any buffered output into the child
+  fflush(stdout);
+  fflush(stderr);
+  
+  pid_t process = fork();
+  if (process < 0) {
+    close(input[0]);
+    close(input[1]);
+    close(output[0]);
+    close(output[1]);
+    close(diagnostics[0]);
+    close(diagnostics[1]);
+    return false;
+  } else if (process == 0) {
+    // Only keep our own ends of our own pipes
+    for (ForkedWorker &other : workers)
+      if (other.process > 0) {
+        close(other.input);
+        close(other.output);
+        close(other.diagnostics);
+      }
+    close(input[1]);
+    close(output[0]);
+    close(diagnostics[0]);
+    signal(SIGPIPE, SIG_DFL);
+    runForkedWorker(environment, schedule, input[0], output[1],
+      diagnostics[1], worker.isolated);
+  }
+  
+  // Lead the process group here as well, so that it exists before the worker
+  // could be killed
+  if (worker.isolated)
+    setpgid(process, process);
+  close(input[0]);
+  close(output[1]);
+  close(diagnostics[1]);
+  worker.process = process;
+  worker.input = input[1];
+  worker.output = output[0];
+  worker.diagnostics = diagnostics[0];
+  worker.busy = false;
+  return true;
+}
+
+/// Close the pipes of a worker and wait for it to exit.
+/// \returns
+///   The exit status of the worker.
+static int reapForkedWorker(ForkedWorker &worker) {
+  close(worker.input);
+  close(worker.output);
+  close(worker.diagnostics);
+  int status = 0;
+  while (waitpid(worker.process, &status, 0) < 0 && errno == EINTR) { }
+  worker.process = -1;
+  worker.busy = false;
+  return status;
+}
+
+/// Get the call stack of a worker that is stuck in a test case, then kill it.
+/// \returns
+///   The call stack of the worker, or an empty string if it couldn't be
+///   captured.
+static std::string killStuckWorker(ForkedWorker &worker) {
+  // Isolated workers are stuck in the child process of the test case
+  pid_t target = worker.isolated ? -worker.process : worker.process;
+  std::string stack = { };
+  if (NAMESPACE_EXPECT stackSignal() != 0 &&
+      kill(target, NAMESPACE_EXPECT stackSignal()) == 0) {
+    // Read until the worker has been quiet for a moment
+    pollfd file { worker.diagnostics, POLLIN, 0 };
+    char buffer[4096];
+    while (poll(&file, 1, stack.empty() ? 500 : 50) > 0) {
+      ssize_t size = read(worker.diagnostics, buffer, sizeof(buffer));
+      if (size <= 0)
+        break;
+      stack.append(buffer, size);
+    }
+  }
+  kill(target, SIGKILL);
+  reapForkedWorker(worker);
+  return stack;
+}
+
+#endif
+
+
+
+NAMESPACE_EXPECT Report NAMESPACE_EXPECT runForkedTests(
+  Environment                    &environment,
+  std::vector<ScheduledTest>     &schedule   ,
+  size_t                          processes  ,
+  std::function<void(RunState &)> state      ,
+  bool                            isolate
+) {
+#if _EXPECT_FORK
+  Collector collector { schedule, state };
+  if (processes == 0)
+    processes = std::max(std::thread::hardware_concurrency(), 1u);
+  processes = std::max<size_t>(std::min(processes, schedule.size()), 1);
+  
+  // A crashed worker must not take the driver down with a broken pipe
+  void (*lastPipeHandler)(int) = signal(SIGPIPE, SIG_IGN);
+  
+  std::vector<ForkedWorker> workers(processes);
+  for (ForkedWorker &worker : workers) {
+    worker.isolated = isolate;
+    spawnForkedWorker(worker, workers, environment, schedule);
+  }
+  long long isolationTime = 0;
+  
+  // Hand out the longest test cases first
+  std::vector<size_t> order = dispatchOrder(schedule);
+  size_t next = 0, finished = 0, lost = 0;
+  while (finished < schedule.size()) {
+    // Hand out test cases to idle workers, unless every worker in a row has
+    // exited before it could be handed one
+    for (ForkedWorker &worker : workers) {
+      if (next >= schedule.size() || lost > processes)
+        break;
+      if (worker.process < 0 &&
+          !spawnForkedWorker(worker, workers, environment, schedule))
+        continue;
+      if (worker.busy)
+        continue;
+      
+      std::string message = { };
+      writeInteger(message, order[next]);
+      if (!sendMessage(worker.input, message)) {
+        // The worker exited while idle: replace it, and hand the test case
+        // out again, since it never ran
+        reapForkedWorker(worker);
+        lost++;
+        continue;
+      }
+      lost = 0;
+      worker.busy = true;
+      worker.test = order[next++];
+      worker.start = std::chrono::steady_clock::now();
+      worker.limit =
+        schedule[worker.test].test->timeLimit(environment.timeout);
+      collector.start(worker.test);
+    }
+    
+    // Wait for results
+    std::vector<pollfd> files = { };
+    std::vector<ForkedWorker *> polled = { };
+    for (ForkedWorker &worker : workers)
+      if (worker.busy) {
+        files.push_back(pollfd { worker.output, POLLIN, 0 });
+        polled.push_back(&worker);
+      }
+    if (files.empty()) {
+      // Replace the workers that exited while idle
+      if (lost > 0 && lost <= processes)
+        continue;
+      
+      // No worker could be started
+      fprintf(stderr, "Unable to start a worker process: %s\n",
+        strerror(errno));
+      break;
+    }
+    
+    // Wake up in time for the nearest time limit
+    int timeout = -1;
+    auto now = std::chrono::steady_clock::now();
+    for (ForkedWorker *worker : polled)
+      if (worker->limit > 0) {
+        auto deadline =
+          worker->start + std::chrono::milliseconds(worker->limit);
+        long long remaining = std::max(0ll, (long long)
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - now).count() + 1);
+        if (timeout < 0 || remaining < timeout)
+          timeout = (int)std::min(remaining, 1ll << 30);
+      }
+    if (poll(files.data(), files.size(), timeout) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    
+    for (size_t i = 0; i < files.size(); i++) {
+      if (files[i].revents == 0)
+        continue;
+      ForkedWorker &worker = *polled[i];
+      
+      std::string message;
+      uint64_t index, overhead;
+      TestResult result { };
+      const char *data = nullptr;
+      if (receiveMessage(worker.output, message) &&
+          (data = message.data(),
+            readInteger(data, data + message.size(), index)) &&
+          index == worker.test &&
+          readResult(data, message.data() + message.size(), result) &&
+          readInteger(data, message.data() + message.size(), overhead)) {
+        worker.busy = false;
+        isolationTime += (long long)overhead;
+      } else {
+        // The worker died while running the test: fail the test and replace
+        // the worker
+        result = TestResult { };
+        result.success = false;
+        result.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - worker.start).count();
+        result.failures.push_back(Failure {
+          describeForkedExit(reapForkedWorker(worker))
+        });
+      }
+      
+      finished++;
+      collector.finish(worker.test, std::move(result));
+    }
+    
+    // Kill the workers whose test case ran out of time and replace them
+    now = std::chrono::steady_clock::now();
+    for (ForkedWorker *worker : polled) {
+      if (!worker->busy || worker->limit <= 0 ||
+          now < worker->start + std::chrono::milliseconds(worker->limit))
+        continue;
+      
+      TestResult result { };
+      result.success = false;
+      result.timedOut = true;
+      result.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        now - worker->start).count();
+      result.failures.push_back(Failure {
+        std::string("Test timed out after ")
+          .append(std::to_string(worker->limit))
+          .append(" ms.")
+      });
+      std::string stack = killStuckWorker(*worker);
+      if (!stack.empty()) {
+        std::string message = "Worker process is at:";
+        size_t begin = 0, end;
+        while ((end = stack.find('\n', begin)) != std::string::npos) {
+          message.append("\n      ").append(stack, begin, end - begin);
+          begin = end + 1;
+        }
+        result.failures.push_back(Failure { message });
+      }
+      
+      finished++;
+      collector.finish(worker->test, std::move(result));
+    }
+  }
+  
+  // Let the workers teardown and exit
+  for (ForkedWorker &worker : workers)
+    if (worker.process > 0)
+      reapForkedWorker(worker);
+  signal(SIGPIPE, lastPipeHandler);
+  
+  Report report = collector.report();
+  report.isolationTime = isolationTime;
+  return report;
+#else
+  (void)isolate;
+  return runTests(environment, schedule, processes, state);
+#endif
+}
+
+NAMESPACE_EXPECT Report NAMESPACE_EXPECT rerunFailures(
+  Environment                    &environment,
+  std::vector<ScheduledTest>     &schedule   ,
+  size_t                          reruns     ,
+  std::function<void(RunState &)> state      ,
+  std::function<void(Suite &, Test &, size_t)> rerun,
+  std::function<Report(
+    std::vector<ScheduledTest> &, std::function<void(RunState &)>)> run
+) {
+  // Only note which test cases failed while the run is going, since its
+  // workers may still be running other test cases
+  std::vector<ScheduledTest> failures = { };
+  Suite *suite = nullptr;
+  Report report = run(schedule, [&](RunState &_state) -> void {
+    if (_state.state == RunState::State::RunningTest)
+      suite = &((RunningTest &)_state).suite;
+    if (_state.state == RunState::State::TestFailed && suite != nullptr) {
+      TestFailed &failed = (TestFailed &)_state;
+      failures.push_back(
+        ScheduledTest { suite, &failed.test, failed.time, false });
+    }
+    if (state != nullptr)
+      state(_state);
+  });
+  
+  // Rerun each failed test case concurrently once the run has finished
+  size_t flaky = 0, deterministic = 0;
+  for (ScheduledTest &failed : failures) {
+    if (reruns == 0)
+      break;
+    std::vector<ScheduledTest> copies(reruns, failed);
+    size_t passed = 0;
+    runForkedTests(environment, copies, reruns,
+      [&](RunState &_state) -> void {
+        if (_state.state == RunState::State::TestSuccess)
+          passed++;
+      });
+    if (passed > 0)
+      flaky++;
+    else
+      deterministic++;
+    if (rerun != nullptr)
+      rerun(*failed.suite, *failed.test, passed);
+  }
+  report.totalFlaky = flaky;
+  report.totalDeterministic = deterministic;
+  return report;
+}
@@ -0,0 +1,178 @@
+// ===--- Schedule.cpp ------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of test case scheduling and result collection.              //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Driver/Schedule.h>
+#include <Driver/Driver.h>
+#include <algorithm>
+
+std::vector<NAMESPACE_EXPECT ScheduledTest> NAMESPACE_EXPECT enabledTests() {
+  std::vector<ScheduledTest> schedule = { };
+  for (Suite *suite : suites())
+    for (Test &test : suite->tests)
+      if (test.enabled)
+        schedule.push_back(ScheduledTest { suite, &test, -1, false });
+  return schedule;
+}
+
+void NAMESPACE_EXPECT shuffleTests(
+  std::vector<ScheduledTest> &schedule,
+  uint64_t                    seed
+) {
+  // SplitMix64, which unlike the standard distributions gives the same
+  // sequence everywhere
+  auto random = [&](size_t bound) -> size_t {
+    uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return (size_t)((z ^ (z >> 31)) % bound);
+  };
+  auto shuffle = [&](std::vector<size_t> &order) {
+    for (size_t i = order.size(); i > 1; i--)
+      std::swap(order[i - 1], order[random(i)]);
+  };
+  
+  // Find where each test suite starts
+  std::vector<size_t> starts = { };
+  for (size_t i = 0; i < schedule.size(); i++)
+    if (i == 0 || schedule[i].suite != schedule[i - 1].suite)
+      starts.push_back(i);
+  starts.push_back(schedule.size());
+  
+  std::vector<size_t> suiteOrder = { };
+  for (size_t i = 0; i + 1 < starts.size(); i++)
+    suiteOrder.push_back(i);
+  shuffle(suiteOrder);
+  
+  std::vector<ScheduledTest> shuffled = { };
+  for (size_t suite : suiteOrder) {
+    std::vector<size_t> testOrder = { };
+    for (size_t i = starts[suite]; i < starts[suite + 1]; i++)
+      testOrder.push_back(i);
+    shuffle(testOrder);
+    for (size_t i : testOrder) {
+      shuffled.push_back(schedule[i]);
+      shuffled.back().time = -1;
+      shuffled.back().first = false;
+    }
+  }
+  schedule = shuffled;
+}
+
+std::vector<size_t> NAMESPACE_EXPECT dispatchOrder(
+  const std::vector<ScheduledTest> &schedule
+) {
+  std::vector<size_t> order = { };
+  for (size_t i = 0; i < schedule.size(); i++)
+    order.push_back(i);
+  std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+    if (schedule[lhs].first != schedule[rhs].first)
+      return schedule[lhs].first;
+    return schedule[lhs].time > schedule[rhs].time;
+  });
+  return order;
+}
+
+long long NAMESPACE_EXPECT expectedTime(
+  const std::vector<ScheduledTest> &schedule
+) {
+  long long total = 0, count = 0;
+  for (const ScheduledTest &scheduled : schedule)
+    if (scheduled.time >= 0) {
+      total += scheduled.time;
+      count++;
+    }
+  return count > 0 ? std::max(total / count, 1ll) : 1;
+}
+
+
+
+NAMESPACE_EXPECT Collector::Collector(
+  std::vector<ScheduledTest>     &schedule,
+  std::function<void(RunState &)> state
+) : schedule(schedule), state(state), results(schedule.size()),
+    finished(schedule.size(), false), index(schedule.size(), 0),
+    count(schedule.size(), 0) {
+  // Find the position of each test case within its test suite
+  size_t begin = 0;
+  for (size_t i = 0; i <= schedule.size(); i++)
+    if (i == schedule.size() || schedule[i].suite != schedule[begin].suite) {
+      for (size_t j = begin; j < i; j++) {
+        index[j] = j - begin + 1;
+        count[j] = i - begin;
+      }
+      begin = i;
+    }
+}
+
+void NAMESPACE_EXPECT Collector::start(size_t test) {
+  if (test != next || nextStarted)
+    return;
+  nextStarted = true;
+  
+  ScheduledTest &scheduled = schedule[test];
+  if (index[test] == 1) {
+    suiteSuccessful = 0;
+    if (state != nullptr) {
+      RunningSuite _state(*scheduled.suite);
+      state(_state);
+    }
+  }
+  if (state != nullptr) {
+    RunningTest _state(
+      *scheduled.suite, *scheduled.test, index[test], count[test]);
+    state(_state);
+  }
+}
+
+void NAMESPACE_EXPECT Collector::finish(size_t test, TestResult result) {
+  results[test] = std::move(result);
+  finished[test] = true;
+  
+  // Report all of the results that are now in order
+  while (next < schedule.size() && finished[next]) {
+    start(next);
+    
+    ScheduledTest &scheduled = schedule[next];
+    TestResult &_result = results[next];
+    if (_result.success) {
+      if (state != nullptr) {
+        TestSuccess _state(*scheduled.test, _result.benchmarks, _result.time);
+        state(_state);
+      }
+      suiteSuccessful++;
+      totalSuccessful++;
+    } else {
+      if (state != nullptr) {
+        TestFailed _state(*scheduled.test, _result.failures, _result.time);
+        _state.timedOut = _result.timedOut;
+        state(_state);
+      }
+    }
+    if (_result.timedOut)
+      totalTimedOut++;
+    total++;
+    
+    if (index[next] == count[next] && state != nullptr) {
+      FinishedSuite _state(*scheduled.suite, suiteSuccessful, count[next]);
+      state(_state);
+    }
+    
+    // The result is no longer needed
+    _result = TestResult();
+    next++;
+    nextStarted = false;
+  }
+}
+
+NAMESPACE_EXPECT Report NAMESPACE_EXPECT Collector::report() {
+  Report report { totalSuccessful, total };
+  report.totalTimedOut = totalTimedOut;
+  return report;
+}
@@ -0,0 +1,73 @@
+// ===--- Shard.cpp ---------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of splitting a test run across several machines.           //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Driver/Shard.h>
+#include <algorithm>
+#include <string.h>
+#include <stdint.h>
+
+/// Hash a test case by its test suite and test case names (64-bit FNV-1a).
+static uint64_t shardHash(
+  NAMESPACE_EXPECT Suite &suite,
+  NAMESPACE_EXPECT Test  &test
+) {
+  uint64_t hash = 14695981039346656037ull;
+  auto mix = [&](const char *string, size_t length) -> void {
+    for (size_t i = 0; i < length; i++) {
+      hash ^= (unsigned char)string[i];
+      hash *= 1099511628211ull;
+    }
+  };
+  mix(suite.name, strlen(suite.name));
+  mix("\t", 1);
+  mix(test.name, strlen(test.name));
+  return hash;
+}
+
+size_t NAMESPACE_EXPECT shardOf(
+  Suite &suite,
+  Test  &test ,
+  size_t count
+) {
+  return (size_t)(shardHash(suite, test) % count);
+}
+
+std::vector<size_t> NAMESPACE_EXPECT assignShards(
+  const std::vector<ScheduledTest> &schedule,
+  size_t                            count   ,
+  bool                              balance
+) {
+  std::vector<size_t> shards(schedule.size(), 0);
+  std::vector<size_t> timed = { };
+  for (size_t i = 0; i < schedule.size(); i++)
+    if (balance && schedule[i].time >= 0)
+      timed.push_back(i);
+    else
+      shards[i] = shardOf(*schedule[i].suite, *schedule[i].test, count);
+  
+  // Pack the timed test cases, longest first, into the shard with the least
+  // expected time, breaking ties by name so every machine agrees
+  std::sort(timed.begin(), timed.end(), [&](size_t lhs, size_t rhs) {
+    if (schedule[lhs].time != schedule[rhs].time)
+      return schedule[lhs].time > schedule[rhs].time;
+    int suite = strcmp(schedule[lhs].suite->name, schedule[rhs].suite->name);
+    if (suite != 0)
+      return suite < 0;
+    return strcmp(schedule[lhs].test->name, schedule[rhs].test->name) < 0;
+  });
+  std::vector<long long> load(count, 0);
+  for (size_t i : timed) {
+    size_t shard = std::min_element(load.begin(), load.end()) - load.begin();
+    load[shard] += schedule[i].time;
+    shards[i] = shard;
+  }
+  
+  return shards;
+}
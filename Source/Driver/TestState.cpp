@@ -43,8 +43,9 @@ NAMESPACE_EXPECT RunningTest::RunningTest(
 
 NAMESPACE_EXPECT TestSuccess::TestSuccess(
   Test                         &test      ,
-  std::vector<BenchmarkResult> &benchmarks
-) : test(test), benchmarks(benchmarks) {
+  std::vector<BenchmarkResult> &benchmarks,
+  long long                     time
+) : test(test), benchmarks(benchmarks), time(time) {
   state = State::TestSuccess;
 }
 
@@ -52,7 +53,8 @@ NAMESPACE_EXPECT TestSuccess::TestSuccess(
 
 NAMESPACE_EXPECT TestFailed::TestFailed(
   Test                 &test    ,
-  std::vector<Failure> &failures
-) : test(test), failures(failures) {
+  std::vector<Failure> &failures,
+  long long             time
+) : test(test), failures(failures), time(time) {
   state = State::TestFailed;
 }
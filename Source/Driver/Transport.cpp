@@ -0,0 +1,327 @@
+// ===--- Transport.cpp ------------------------------------------ C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of sending test results between processes.                  //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Driver/Transport.h>
+#include <string.h>
+#include <initializer_list>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+void NAMESPACE_EXPECT writeInteger(
+  std::string &message,
+  uint64_t     value
+) {
+  for (int i = 0; i < 8; i++)
+    message.push_back((char)(value >> 8 * i));
+}
+
+void NAMESPACE_EXPECT writeDouble(
+  std::string &message,
+  double       value
+) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  writeInteger(message, bits);
+}
+
+void NAMESPACE_EXPECT writeString(
+  std::string       &message,
+  const std::string &value
+) {
+  writeInteger(message, value.size());
+  message.append(value);
+}
+
+void NAMESPACE_EXPECT writeResult(
+  std::string      &message,
+  const TestResult &result
+) {
+  writeInteger(message, result.success);
+  writeInteger(message, (uint64_t)result.time);
+  
+  writeInteger(message, result.failures.size());
+  for (const Failure &failure : result.failures)
+    writeString(message, failure.message);
+  
+  writeInteger(message, result.benchmarks.size());
+  for (const BenchmarkResult &benchmark : result.benchmarks) {
+    writeInteger(message, (uint64_t)benchmark.line);
+    writeInteger(message, benchmark.iterations);
+    writeInteger(message, (uint64_t)benchmark.totalTime);
+    writeDouble(message, benchmark.meanTime);
+    writeDouble(message, benchmark.medianTime);
+    writeDouble(message, benchmark.minTime);
+    writeDouble(message, benchmark.maxTime);
+    writeDouble(message, benchmark.q1Time);
+    writeDouble(message, benchmark.q3Time);
+    writeInteger(message, benchmark.times.size());
+    for (double time : benchmark.times)
+      writeDouble(message, time);
+    writeDouble(message, benchmark.precision);
+    writeInteger(message, benchmark.batch);
+    for (double counter : {
+        benchmark.cycles, benchmark.instructions, benchmark.branchMisses,
+        benchmark.l1dMisses, benchmark.llcMisses, benchmark.dtlbMisses,
+        benchmark.ipc, benchmark.allocations, benchmark.allocatedBytes })
+      writeDouble(message, counter);
+    writeInteger(message, (uint64_t)benchmark.peakBytes);
+    writeInteger(message, benchmark.parameters.size());
+    for (const BenchmarkParameter &parameter : benchmark.parameters) {
+      writeString(message, parameter.name);
+      writeInteger(message, (uint64_t)parameter.value);
+    }
+  }
+}
+
+
+
+bool NAMESPACE_EXPECT readInteger(
+  const char *&data ,
+  const char  *end  ,
+  uint64_t    &value
+) {
+  if (end - data < 8)
+    return false;
+  value = 0;
+  for (int i = 0; i < 8; i++)
+    value |= (uint64_t)(unsigned char)*data++ << 8 * i;
+  return true;
+}
+
+bool NAMESPACE_EXPECT readDouble(
+  const char *&data ,
+  const char  *end  ,
+  double      &value
+) {
+  uint64_t bits;
+  if (!readInteger(data, end, bits))
+    return false;
+  memcpy(&value, &bits, sizeof(value));
+  return true;
+}
+
+bool NAMESPACE_EXPECT readString(
+  const char *&data ,
+  const char  *end  ,
+  std::string &value
+) {
+  uint64_t size;
+  if (!readInteger(data, end, size) || (uint64_t)(end - data) < size)
+    return false;
+  value.assign(data, size);
+  data += size;
+  return true;
+}
+
+bool NAMESPACE_EXPECT readResult(
+  const char *&data  ,
+  const char  *end   ,
+  TestResult  &result
+) {
+  uint64_t value, count;
+  if (!readInteger(data, end, value))
+    return false;
+  result.success = value != 0;
+  if (!readInteger(data, end, value))
+    return false;
+  result.time = (long long)value;
+  
+  if (!readInteger(data, end, count))
+    return false;
+  result.failures.clear();
+  for (uint64_t i = 0; i < count; i++) {
+    Failure failure { };
+    if (!readString(data, end, failure.message))
+      return false;
+    result.failures.push_back(failure);
+  }
+  
+  if (!readInteger(data, end, count))
+    return false;
+  result.benchmarks.clear();
+  for (uint64_t i = 0; i < count; i++) {
+    uint64_t fields[3], times, batch;
+    double statistics[6];
+    for (uint64_t &field : fields)
+      if (!readInteger(data, end, field))
+        return false;
+    for (double &statistic : statistics)
+      if (!readDouble(data, end, statistic))
+        return false;
+    if (!readInteger(data, end, times))
+      return false;
+    BenchmarkResult benchmark {
+      (int)fields[0],
+      (size_t)fields[1],
+      (long long)fields[2],
+      statistics[0],
+      statistics[1],
+      statistics[2],
+      statistics[3],
+      statistics[4],
+      statistics[5],
+      { },
+      0,
+      1,
+      -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1,
+      { }
+    };
+    for (uint64_t j = 0; j < times; j++) {
+      double time;
+      if (!readDouble(data, end, time))
+        return false;
+      benchmark.times.push_back(time);
+    }
+    if (!readDouble(data, end, benchmark.precision) ||
+        !readInteger(data, end, batch))
+      return false;
+    for (double *counter : {
+        &benchmark.cycles, &benchmark.instructions, &benchmark.branchMisses,
+        &benchmark.l1dMisses, &benchmark.llcMisses, &benchmark.dtlbMisses,
+        &benchmark.ipc, &benchmark.allocations, &benchmark.allocatedBytes })
+      if (!readDouble(data, end, *counter))
+        return false;
+    uint64_t peakBytes;
+    if (!readInteger(data, end, peakBytes))
+      return false;
+    benchmark.peakBytes = (long long)peakBytes;
+    uint64_t parameters;
+    if (!readInteger(data, end, parameters))
+      return false;
+    for (uint64_t j = 0; j < parameters; j++) {
+      BenchmarkParameter parameter;
+      uint64_t value;
+      if (!readString(data, end, parameter.name) ||
+          !readInteger(data, end, value))
+        return false;
+      parameter.value = (long long)value;
+      benchmark.parameters.push_back(parameter);
+    }
+    benchmark.batch = (size_t)batch;
+    result.benchmarks.push_back(benchmark);
+  }
+  
+  return true;
+}
+
+
+
+/// Write an entire buffer to a file descriptor.
+static bool writeAll(int file, const char *data, size_t size) {
+  while (size > 0) {
+    #if defined(_WIN32)
+    int written = _write(file, data, (unsigned)size);
+    #else
+    ssize_t written = write(file, data, size);
+    if (written < 0 && errno == EINTR)
+      continue;
+    #endif
+    if (written <= 0)
+      return false;
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+/// Fill an entire buffer from a file descriptor.
+static bool readAll(int file, char *data, size_t size) {
+  while (size > 0) {
+    #if defined(_WIN32)
+    int read = _read(file, data, (unsigned)size);
+    #else
+    ssize_t read = ::read(file, data, size);
+    if (read < 0 && errno == EINTR)
+      continue;
+    #endif
+    if (read <= 0)
+      return false;
+    data += read;
+    size -= read;
+  }
+  return true;
+}
+
+bool NAMESPACE_EXPECT sendMessage(
+  int                file   ,
+  const std::string &message
+) {
+  std::string packet = { };
+  writeInteger(packet, message.size());
+  packet.append(message);
+  return writeAll(file, packet.data(), packet.size());
+}
+
+bool NAMESPACE_EXPECT receiveMessage(
+  int          file   ,
+  std::string &message
+) {
+  char header[8];
+  if (!readAll(file, header, 8))
+    return false;
+  const char *data = header;
+  uint64_t size;
+  readInteger(data, header + 8, size);
+  message.resize(size);
+  return size == 0 || readAll(file, &message[0], size);
+}
+
+bool NAMESPACE_EXPECT clearSocketPath(const char *path) {
+  #if defined(_WIN32)
+  (void)path;
+  return true;
+  #else
+  struct stat status;
+  if (lstat(path, &status) != 0) {
+    if (errno == ENOENT)
+      return true;
+    fprintf(stderr, "Unable to check '%s': %s\n", path, strerror(errno));
+    return false;
+  }
+  if (!S_ISSOCK(status.st_mode)) {
+    fprintf(stderr, "'%s' already exists and is not a socket.\n", path);
+    return false;
+  }
+  
+  // Only a socket that nothing accepts connections on any more is stale
+  sockaddr_un address { };
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Socket path '%s' is too long.\n", path);
+    return false;
+  }
+  strcpy(address.sun_path, path);
+  int file = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (file < 0) {
+    fprintf(stderr, "Unable to create a socket: %s\n", strerror(errno));
+    return false;
+  }
+  bool live = connect(file, (sockaddr *)&address, sizeof(address)) == 0;
+  close(file);
+  if (live) {
+    fprintf(stderr, "A server is already listening on '%s'.\n", path);
+    return false;
+  }
+  if (unlink(path) != 0 && errno != ENOENT) {
+    fprintf(stderr, "Unable to remove '%s': %s\n", path, strerror(errno));
+    return false;
+  }
+  return true;
+  #endif
+}
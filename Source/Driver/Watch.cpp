@@ -0,0 +1,218 @@
+// ===--- Watch.cpp ---------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of watching the test executable and sources for changes.    //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Driver/Watch.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#endif
+#include <stdio.h>
+
+#if defined(__linux__)
+/// The changes that count as a change to a watched file.
+#define _EXPECT_WATCH_EVENTS \
+  (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
+
+/// Get the absolute path of a file, which may not exist yet.
+static std::string absolutePath(const std::string &path) {
+  char resolved[PATH_MAX];
+  if (realpath(path.c_str(), resolved) != NULL)
+    return resolved;
+  
+  // Resolve the directory of a file that doesn't exist
+  size_t slash = path.rfind('/');
+  std::string directory = slash == std::string::npos ? "." :
+    slash == 0 ? "/" : path.substr(0, slash);
+  if (realpath(directory.c_str(), resolved) == NULL)
+    return path;
+  std::string absolute = resolved;
+  if (absolute.back() != '/')
+    absolute.push_back('/');
+  return absolute.append(path, slash == std::string::npos ? 0 : slash + 1,
+    std::string::npos);
+}
+
+/// Check whether a path is ignored by a watcher, as one of its ignored paths,
+/// a temporary file written next to one, or a file within one.
+static bool ignoredPath(
+  const NAMESPACE_EXPECT Watcher &watcher,
+  const std::string              &path
+) {
+  for (const std::string &ignored : watcher.ignored)
+    if (path.compare(0, ignored.size(), ignored) == 0 &&
+        (path.size() == ignored.size() || path[ignored.size()] == '.' ||
+         path[ignored.size()] == '/'))
+      return true;
+  return false;
+}
+
+/// Watch a directory and all of its subdirectories, skipping hidden and
+/// ignored ones.
+static void watchDirectory(
+  NAMESPACE_EXPECT Watcher &watcher  ,
+  const std::string        &directory
+) {
+  if (ignoredPath(watcher, directory))
+    return;
+  int watch = inotify_add_watch(
+    watcher.file, directory.c_str(), _EXPECT_WATCH_EVENTS);
+  if (watch < 0)
+    return;
+  watcher.watched[watch] = directory;
+  
+  // Every file that isn't ignored matters in the directory of the executable
+  // if it is also a source directory
+  if (watch == watcher.executableWatch)
+    watcher.executableName.clear();
+  
+  DIR *entries = opendir(directory.c_str());
+  if (entries == NULL)
+    return;
+  for (dirent *entry = readdir(entries); entry != NULL;
+       entry = readdir(entries))
+    if (entry->d_type == DT_DIR && entry->d_name[0] != '.')
+      watchDirectory(watcher, std::string(directory).append("/")
+        .append(entry->d_name));
+  closedir(entries);
+}
+#endif
+
+bool NAMESPACE_EXPECT Watcher::open(
+  const char                     *executable ,
+  const std::vector<std::string> &directories,
+  const std::vector<std::string> &ignore
+) {
+  close();
+  #if defined(__linux__)
+  // The executable is watched through its directory, since a rebuild usually
+  // replaces it rather than writing to it
+  char resolved[PATH_MAX];
+  if (realpath(executable, resolved) == NULL) {
+    ssize_t length =
+      readlink("/proc/self/exe", resolved, sizeof(resolved) - 1);
+    if (length <= 0)
+      return false;
+    resolved[length] = '\0';
+  }
+  std::string path = resolved;
+  size_t slash = path.rfind('/');
+  executableName = path.substr(slash + 1);
+  
+  file = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+  if (file < 0)
+    return false;
+  executableWatch = inotify_add_watch(file,
+    slash == 0 ? "/" : path.substr(0, slash).c_str(), _EXPECT_WATCH_EVENTS);
+  if (executableWatch < 0) {
+    close();
+    return false;
+  }
+  watched[executableWatch] = slash == 0 ? "" : path.substr(0, slash);
+  
+  // Compare absolute paths, since the events only give file names
+  for (const std::string &path : ignore)
+    ignored.push_back(absolutePath(path));
+  for (const std::string &directory : directories)
+    watchDirectory(*this, absolutePath(directory));
+  return true;
+  #else
+  (void)executable;
+  (void)directories;
+  (void)ignore;
+  return false;
+  #endif
+}
+
+void NAMESPACE_EXPECT Watcher::close() {
+  #if defined(__linux__)
+  if (file >= 0)
+    ::close(file);
+  #endif
+  file = -1;
+  executableWatch = -1;
+  watched.clear();
+  ignored.clear();
+}
+
+bool NAMESPACE_EXPECT Watcher::wait(long long quiet) {
+  #if defined(__linux__)
+  if (file < 0)
+    return false;
+  
+  // Block until something changes, then keep draining changes until none
+  // arrive for a while
+  bool changed = false;
+  alignas(inotify_event) char buffer[4096];
+  while (true) {
+    pollfd polled { file, POLLIN, 0 };
+    int ready = poll(&polled, 1, changed ? (int)quiet : -1);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready <= 0)
+      return changed && ready == 0;
+    
+    ssize_t size;
+    while ((size = read(file, buffer, sizeof(buffer))) > 0)
+      for (char *next = buffer; next < buffer + size; ) {
+        inotify_event *event = (inotify_event *)next;
+        next += sizeof(inotify_event) + event->len;
+        
+        // Only the executable itself matters in its directory, and hidden
+        // files, such as editor swap files, and the files written by the run
+        // itself don't matter anywhere
+        const char *name = event->len > 0 ? event->name : "";
+        if (event->wd == executableWatch && !executableName.empty() &&
+            executableName != name)
+          continue;
+        if (name[0] == '.')
+          continue;
+        auto directory = watched.find(event->wd);
+        if (directory != watched.end() && ignoredPath(*this,
+            std::string(directory->second).append("/").append(name)))
+          continue;
+        changed = true;
+      }
+  }
+  #else
+  (void)quiet;
+  return false;
+  #endif
+}
+
+void NAMESPACE_EXPECT rerunTests(
+  int   argc  ,
+  char *argv[]
+) {
+  #if defined(__linux__)
+  std::vector<char *> arguments(argv, argv + argc);
+  bool failedFirst = false;
+  for (char *argument : arguments)
+    if (strcmp(argument, "--failed-first") == 0)
+      failedFirst = true;
+  static char flag[] = "--failed-first";
+  if (!failedFirst)
+    arguments.push_back(flag);
+  arguments.push_back(nullptr);
+  
+  fflush(stdout);
+  fflush(stderr);
+  setenv("EXPECT_WATCH_RERUN", "1", 1);
+  execvp(argv[0], arguments.data());
+  #else
+  (void)argc;
+  (void)argv;
+  #endif
+}
@@ -0,0 +1,164 @@
+// ===--- Watchdog.cpp ------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of diagnosing test cases that exceed their time limit.      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Driver/Watchdog.h>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#if defined(__linux__) && defined(__GLIBC__)
+#include <execinfo.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#define _EXPECT_STACKS 1
+#endif
+
+#if _EXPECT_STACKS
+
+/// The most frames captured per call stack.
+#define _EXPECT_STACK_FRAMES 64
+/// The most threads whose call stacks are captured at once.
+#define _EXPECT_STACK_THREADS 256
+
+/// A call stack captured by a thread from its signal handler.
+struct CapturedStack {
+  /// The captured frames.
+  void *frames[_EXPECT_STACK_FRAMES];
+  /// The number of captured frames.
+  int size;
+  /// The thread that captured the call stack.
+  long long thread;
+};
+
+static CapturedStack capturedStacks[_EXPECT_STACK_THREADS];
+static std::atomic<int> capturedStackCount { 0 };
+static std::atomic<int> finishedStackCount { 0 };
+static int stackDumpFile = -1;
+
+/// Capture the call stack of the interrupted thread.
+static void captureStackHandler(int) {
+  int slot = capturedStackCount.fetch_add(1);
+  if (slot < _EXPECT_STACK_THREADS) {
+    CapturedStack &stack = capturedStacks[slot];
+    stack.size = backtrace(stack.frames, _EXPECT_STACK_FRAMES);
+    stack.thread = syscall(SYS_gettid);
+  }
+  finishedStackCount.fetch_add(1);
+}
+
+/// Write the call stack of the interrupted thread to the stack dump file.
+static void dumpStackHandler(int) {
+  void *frames[_EXPECT_STACK_FRAMES];
+  int size = backtrace(frames, _EXPECT_STACK_FRAMES);
+  // Skip the signal handler frames
+  if (size > 2)
+    backtrace_symbols_fd(frames + 2, size - 2, stackDumpFile);
+}
+
+/// Install a handler for the stack signal.
+static void installStackHandler(void (*handler)(int)) {
+  // Load the unwinder up front, it can't be loaded from a signal handler
+  void *frames[1];
+  backtrace(frames, 1);
+  
+  struct sigaction action { };
+  action.sa_handler = handler;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(NAMESPACE_EXPECT stackSignal(), &action, nullptr);
+}
+
+#endif
+
+
+
+long long NAMESPACE_EXPECT currentThread() {
+#if _EXPECT_STACKS
+  return syscall(SYS_gettid);
+#else
+  return 0;
+#endif
+}
+
+std::vector<NAMESPACE_EXPECT Failure> NAMESPACE_EXPECT captureStacks(
+  long long highlight
+) {
+  std::vector<Failure> stacks = { };
+#if _EXPECT_STACKS
+  installStackHandler(captureStackHandler);
+  capturedStackCount = 0;
+  finishedStackCount = 0;
+  
+  // Interrupt every other thread in the process
+  int requested = 0;
+  long long self = currentThread();
+  if (DIR *tasks = opendir("/proc/self/task")) {
+    while (dirent *task = readdir(tasks)) {
+      long long thread = atoll(task->d_name);
+      if (thread <= 0 || thread == self)
+        continue;
+      if (syscall(SYS_tgkill, getpid(), (pid_t)thread, stackSignal()) == 0)
+        requested++;
+    }
+    closedir(tasks);
+  }
+  
+  // Give the threads a moment to respond
+  auto deadline =
+    std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+  while (finishedStackCount < requested &&
+    std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  
+  int count = std::min(capturedStackCount.load(), _EXPECT_STACK_THREADS);
+  for (int i = 0; i < count; i++) {
+    CapturedStack &stack = capturedStacks[i];
+    std::string message = std::string("Thread ")
+      .append(std::to_string(stack.thread))
+      .append(stack.thread == highlight ? " (timed out)" : "")
+      .append(" is at:");
+    if (char **symbols = backtrace_symbols(stack.frames, stack.size)) {
+      // Skip the signal handler frames
+      for (int j = 2; j < stack.size; j++)
+        message.append("\n      ").append(symbols[j]);
+      free(symbols);
+    }
+    stacks.push_back(Failure { message });
+  }
+  if (count < requested)
+    stacks.push_back(Failure {
+      std::to_string(requested - count)
+        .append(" threads did not report their call stack.")
+    });
+#else
+  (void)highlight;
+#endif
+  return stacks;
+}
+
+void NAMESPACE_EXPECT installStackDump(int file) {
+#if _EXPECT_STACKS
+  stackDumpFile = file;
+  installStackHandler(dumpStackHandler);
+#else
+  (void)file;
+#endif
+}
+
+int NAMESPACE_EXPECT stackSignal() {
+#if _EXPECT_STACKS
+  return SIGRTMAX - 3;
+#else
+  return 0;
+#endif
+}
@@ -0,0 +1,56 @@
+// ===--- WorkQueue.cpp ------------------------------------------ C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of a work-stealing queue shared by a set of workers.        //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Driver/WorkQueue.h>
+
+NAMESPACE_EXPECT WorkQueue::WorkQueue(
+  size_t workers
+) {
+  for (size_t i = 0; i < workers; i++)
+    deques.push_back(std::unique_ptr<Deque>(new Deque()));
+}
+
+void NAMESPACE_EXPECT WorkQueue::push(
+  size_t worker,
+  size_t item
+) {
+  Deque &deque = *deques[worker];
+  std::lock_guard<std::mutex> guard(deque.lock);
+  deque.items.push_back(item);
+}
+
+bool NAMESPACE_EXPECT WorkQueue::pop(
+  size_t  worker,
+  size_t &item
+) {
+  // Take from the front of our own queue
+  {
+    Deque &deque = *deques[worker];
+    std::lock_guard<std::mutex> guard(deque.lock);
+    if (!deque.items.empty()) {
+      item = deque.items.front();
+      deque.items.pop_front();
+      return true;
+    }
+  }
+  
+  // Steal from the back of the other queues
+  for (size_t i = 1; stealing && i < deques.size(); i++) {
+    Deque &deque = *deques[(worker + i) % deques.size()];
+    std::lock_guard<std::mutex> guard(deque.lock);
+    if (!deque.items.empty()) {
+      item = deque.items.back();
+      deque.items.pop_back();
+      return true;
+    }
+  }
+  
+  return false;
+}
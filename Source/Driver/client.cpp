@@ -0,0 +1,15 @@
+// ===--- client.cpp --------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// The client for running tests on a test daemon.                             //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Expect>
+
+int main(int argc, char *argv[]) {
+  return NAMESPACE_EXPECT runTestClient(argc, argv);
+}
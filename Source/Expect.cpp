@@ -11,12 +11,31 @@
 #include "Global/toString.cpp"
 #include "Test/Test.cpp"
 #include "Suite/Suite.cpp"
+#include "Suite/Index.cpp"
 #include "Expression/ExactExpression.cpp"
 #include "Expression/MiscExpression.cpp"
 #include "Evaluate/Evaluate.cpp"
 #include "Evaluate/Section.cpp"
 #include "Matching/Matchers.cpp"
 #include "Benchmarking/Benchmark.cpp"
+#include "Benchmarking/Counters.cpp"
+#include "Benchmarking/Allocations.cpp"
+#include "Benchmarking/Family.cpp"
 #include "Driver/TestState.cpp"
+#include "Driver/Schedule.cpp"
+#include "Driver/WorkQueue.cpp"
+#include "Driver/History.cpp"
+#include "Driver/Cache.cpp"
+#include "Driver/Checkpoint.cpp"
+#include "Driver/Shard.cpp"
+#include "Driver/Watchdog.cpp"
+#include "Driver/EventLoop.cpp"
 #include "Driver/Driver.cpp"
+#include "Driver/Transport.cpp"
+#include "Driver/ProcessDriver.cpp"
+#include "Driver/Coordinator.cpp"
+#include "Driver/Daemon.cpp"
+#include "Driver/Plugins.cpp"
+#include "Driver/Watch.cpp"
+#include "Driver/Changes.cpp"
 #include "Driver/CommandLineDriver.cpp"
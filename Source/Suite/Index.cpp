@@ -0,0 +1,81 @@
+// ===--- Index.cpp ---------------------------------------------- C++ ---=== //
+//                                                                            //
+// © 2023, Michael Bykov                                                      //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+//                                                                            //
+// Implementation of looking up registered tests by name and tag.             //
+//                                                                            //
+// ===--------------------------------------------------------------------=== //
+
+#include <Suite/Index.h>
+#include <string.h>
+
+size_t NAMESPACE_EXPECT StringHash::operator () (const char *string) const {
+  // FNV-1a
+  size_t hash = (size_t)14695981039346656037ull;
+  for (; *string != '\0'; string++) {
+    hash ^= (unsigned char)*string;
+    hash *= (size_t)1099511628211ull;
+  }
+  return hash;
+}
+
+bool NAMESPACE_EXPECT StringEqual::operator () (
+  const char *lhs,
+  const char *rhs
+) const {
+  return strcmp(lhs, rhs) == 0;
+}
+
+
+
+void NAMESPACE_EXPECT TestIndex::build(const SuiteList &suites) {
+  this->suites.clear();
+  tests.clear();
+  tags.clear();
+  tagNames.clear();
+  
+  size_t i = 0;
+  for (Suite *suite : suites) {
+    this->suites.insert(std::make_pair(suite->name, std::make_pair(i, suite)));
+    for (Test &test : suite->tests) {
+      tests.insert(std::make_pair(test.name, std::make_pair(i, &test)));
+      for (const char *tag : test.tags) {
+        std::vector<Test *> &tagged = tags[tag];
+        if (tagged.empty())
+          tagNames.push_back(tag);
+        tagged.push_back(&test);
+      }
+    }
+    i++;
+  }
+}
+
+bool NAMESPACE_EXPECT TestIndex::find(
+  const char *name ,
+  Suite     *&suite,
+  Test      *&test
+) const {
+  suite = nullptr;
+  test = nullptr;
+  auto foundSuite = suites.find(name);
+  auto foundTest = tests.find(name);
+  if (foundSuite != suites.end() &&
+      (foundTest == tests.end() ||
+        foundSuite->second.first <= foundTest->second.first))
+    suite = foundSuite->second.second;
+  else if (foundTest != tests.end())
+    test = foundTest->second.second;
+  return suite != nullptr || test != nullptr;
+}
+
+NAMESPACE_EXPECT TestIndex &NAMESPACE_EXPECT testIndex() {
+  static TestIndex index { };
+  static bool built = false;
+  if (!built) {
+    index.build(suites());
+    built = true;
+  }
+  return index;
+}
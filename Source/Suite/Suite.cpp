@@ -10,14 +10,39 @@
 
 #include <Suite/Suite.h>
 
-std::vector<NAMESPACE_EXPECT Suite *> &NAMESPACE_EXPECT suites() {
-  static std::vector<NAMESPACE_EXPECT Suite *> suites = { };
-  return suites;
+/// All registered test suites.
+/// \remarks
+///   Constant initialized, so test suites can register themselves during
+///   static initialization in any order.
+static NAMESPACE_EXPECT SuiteList registeredSuites { };
+
+NAMESPACE_EXPECT SuiteList &NAMESPACE_EXPECT suites() {
+  return registeredSuites;
 }
 
 NAMESPACE_EXPECT Suite::Suite(
   const char *name ,
-  Suite      *suite
-) : name(name) {
-  suites().push_back(suite);
+  Suite      *suite,
+  const char *file ,
+  int         line
+) : name(name), file(file), line(line) {
+  suites().append(*suite);
+}
+
+NAMESPACE_EXPECT Suite::Suite(const char *name) : name(name) {
+  
+}
+
+void NAMESPACE_EXPECT Suite::runSetup() {
+  if (prepare != nullptr)
+    prepare();
+  if (setup != nullptr)
+    setup();
+}
+
+void NAMESPACE_EXPECT Suite::runTeardown() {
+  if (teardown != nullptr)
+    teardown();
+  if (cleanup != nullptr)
+    cleanup();
 }
@@ -9,19 +9,27 @@
 // ===--------------------------------------------------------------------=== //
 
 #include <Test/Test.h>
+#include <algorithm>
+#include <new>
+#include <stdio.h>
 
 NAMESPACE_EXPECT Test::Add::Add(
-  std::vector<Test> *tests      ,
-  const char        *name       ,
-  const char        *description,
-  std::vector<const char *> tags
+  void             *storage    ,
+  LinkedList<Test> &tests      ,
+  const char       *name       ,
+  const char       *description,
+  std::vector<const char *> tags,
+  const char       *file       ,
+  int               line
 ) {
   tags.erase(std::remove_if(tags.begin(), tags.end(), [](const char *element) {
     return *element == '\0';
   }), tags.end());
-  Test test { name, description, nullptr, false, tags };
-  tests->push_back(test);
-  this->test = &tests->at(tests->size() - 1);
+  test = new (storage) Test {
+    name, description, nullptr, nullptr, false, std::move(tags), file, line,
+    nullptr
+  };
+  tests.append(*test);
 }
 
 void NAMESPACE_EXPECT Test::Add::operator, (
@@ -29,3 +37,13 @@ void NAMESPACE_EXPECT Test::Add::operator, (
 ) {
   test->test = body;
 }
+
+long long NAMESPACE_EXPECT Test::timeLimit(long long fallback) const {
+  for (const char *tag : tags) {
+    long long limit;
+    char end;
+    if (sscanf(tag, "timeout ( %lld %c", &limit, &end) == 2 && end == ')')
+      return std::max(limit, 0ll);
+  }
+  return fallback;
+}
@@ -1,5 +1,8 @@
 #include <Expect>
 #include <thread>
+#include <string>
+#include <vector>
+#include <memory>
 
 SUITE(Benchmarks) {
   TEST(test benchmarking, "A description.", benchmark) {
@@ -16,4 +19,41 @@ SUITE(Benchmarks) {
     
     BENCHMARK std::this_thread::sleep_for(std::chrono::nanoseconds(10000000));
   };
+  
+  TEST(selection, "Select tests out of 100k registered tests.", benchmark) {
+    // 1000 suites of 100 tests each, with a tag shared by every suite and a
+    // tag for each suite
+    std::vector<std::string> names;
+    for (int i = 0; i < 1000; i++) {
+      names.push_back("suite " + std::to_string(i));
+      for (int j = 0; j < 100; j++)
+        names.push_back("test " + std::to_string(i * 100 + j));
+    }
+    std::vector<std::unique_ptr<NAMESPACE_EXPECT Suite>> generated;
+    std::vector<NAMESPACE_EXPECT Test> tests;
+    tests.reserve(100000);
+    NAMESPACE_EXPECT SuiteList suites;
+    for (int i = 0; i < 1000; i++) {
+      const char *name = names[i * 101].c_str();
+      generated.push_back(std::unique_ptr<NAMESPACE_EXPECT Suite>(
+        new NAMESPACE_EXPECT Suite(name)));
+      for (int j = 0; j < 100; j++) {
+        tests.push_back(NAMESPACE_EXPECT Test {
+          names[i * 101 + j + 1].c_str(), "", nullptr, nullptr, false,
+          { "generated", name }, nullptr, 0, nullptr
+        });
+        generated.back()->tests.append(tests.back());
+      }
+      suites.append(*generated.back());
+    }
+    
+    NAMESPACE_EXPECT TestIndex index { };
+    BENCHMARK index.build(suites);
+    
+    NAMESPACE_EXPECT Suite *suite;
+    NAMESPACE_EXPECT Test *test;
+    int i = 0;
+    BENCHMARK index.find(names[i++ % names.size()].c_str(), suite, test);
+    BENCHMARK index.tags.find("generated")->second.size();
+  };
 }
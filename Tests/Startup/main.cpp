@@ -0,0 +1,20 @@
+#include <Expect>
+#include <time.h>
+#include <stdio.h>
+
+int main(int argc, char *argv[]) {
+  // All of the processor time used so far went into loading the executable
+  // and static initialization, which registers every test case
+  clock_t startup = clock();
+  
+  size_t tests = 0;
+  for (NAMESPACE_EXPECT Suite *suite : NAMESPACE_EXPECT suites())
+    tests += suite->tests.size();
+  printf("Registered %zu tests in %zu suites in %.3f ms before main.\n",
+    tests, NAMESPACE_EXPECT suites().size(),
+    startup * 1000.0 / CLOCKS_PER_SEC);
+  
+  if (argc > 1)
+    return RUN_COMMAND_LINE_TESTS(argc, argv);
+  return 0;
+}